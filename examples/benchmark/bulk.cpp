@@ -0,0 +1,93 @@
+#include <experimental/thread_pool>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+namespace execution = std::experimental::execution;
+using std::experimental::static_thread_pool;
+
+// Compares bulk_execute, with each of the chunk partitioning modes, against
+// submitting one function per index, which is how bulk_execute used to be
+// implemented. Allocations made through the executor's allocator are counted.
+// Usage: bulk [n] [threads]
+
+std::atomic<std::size_t> allocations{0};
+
+template <class T>
+class counting_allocator
+{
+public:
+  typedef T value_type;
+
+  counting_allocator() noexcept {}
+  template <class U> counting_allocator(const counting_allocator<U>&) noexcept {}
+
+  T* allocate(std::size_t n)
+  {
+    ++allocations;
+    return static_cast<T*>(::operator new(sizeof(T) * n));
+  }
+
+  void deallocate(T* p, std::size_t n)
+  {
+    ::operator delete(p, sizeof(T) * n);
+  }
+};
+
+template<class Workload>
+void run(const char* name, std::size_t threads, std::size_t n, execution::bulk_chunk_size_t chunk, Workload workload)
+{
+  std::atomic<std::size_t> count{0};
+  allocations = 0;
+  auto start = std::chrono::steady_clock::now();
+  {
+    static_thread_pool pool{threads};
+    auto ex = execution::require(pool.executor(), execution::blocking.never,
+        execution::allocator(counting_allocator<void>{}), chunk);
+    workload(ex, count, n);
+    pool.wait();
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << std::left << std::setw(16) << name << std::right << std::fixed;
+  std::cout << std::setw(10) << std::setprecision(1) << elapsed * 1000 << " ms";
+  std::cout << std::setw(14) << std::setprecision(0) << count / elapsed << " indices/s";
+  std::cout << std::setw(10) << allocations << " allocations";
+  std::cout << (count == n ? "" : "  (incomplete)") << "\n";
+}
+
+int main(int argc, char* argv[])
+{
+  std::size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 1000000;
+  std::size_t threads = argc > 2 ? std::strtoul(argv[2], nullptr, 0) : std::max(1u, std::thread::hardware_concurrency());
+
+  std::cout << n << " indices on " << threads << " threads\n";
+
+  using partitioning = execution::bulk_chunk_size_t::partitioning;
+
+  const std::pair<const char*, execution::bulk_chunk_size_t> chunks[] =
+  {
+    {"bulk", execution::bulk_chunk_size},
+    {"bulk chunk 1", execution::bulk_chunk_size(1, partitioning::dynamic)},
+    {"bulk static", execution::bulk_chunk_size(0, partitioning::static_)},
+    {"bulk dynamic", execution::bulk_chunk_size(0, partitioning::dynamic)},
+    {"bulk guided", execution::bulk_chunk_size(0, partitioning::guided)},
+  };
+
+  for (auto& chunk : chunks)
+  {
+    run(chunk.first, threads, n, chunk.second, [](auto ex, auto& count, std::size_t n)
+        {
+          ex.bulk_execute([&count](std::size_t, int&){ ++count; }, n, []{ return 0; });
+        });
+  }
+
+  run("per-index", threads, n, execution::bulk_chunk_size, [](auto ex, auto& count, std::size_t n)
+      {
+        for (std::size_t i = 0; i < n; ++i)
+          ex.execute([&count]{ ++count; });
+      });
+}
@@ -0,0 +1,124 @@
+#include <experimental/thread_pool>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+namespace execution = std::experimental::execution;
+using std::experimental::static_thread_pool;
+
+// Measures task throughput under contention for each of the pool's scheduling
+// strategies. Usage: contention [tasks] [threads]
+
+struct configuration
+{
+  const char* name;
+  static_thread_pool::scheduling schedule;
+  bool steal_continuations;
+};
+
+template<class Workload>
+void run(const char* name, const configuration& c, std::size_t threads, std::size_t tasks, Workload workload)
+{
+  std::atomic<std::size_t> count{0};
+  auto start = std::chrono::steady_clock::now();
+  {
+    static_thread_pool::options options;
+    options.schedule = c.schedule;
+    options.steal_continuations = c.steal_continuations;
+    static_thread_pool pool{threads, options};
+    workload(pool.executor(), count, tasks);
+    pool.wait();
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << std::left << std::setw(22) << c.name;
+  std::cout << std::setw(14) << name << std::right << std::setw(10) << std::fixed << std::setprecision(1) << elapsed * 1000 << " ms";
+  std::cout << std::setw(14) << std::setprecision(0) << count / elapsed << " tasks/s";
+  std::cout << (count == tasks ? "" : "  (incomplete)") << "\n";
+}
+
+// All tasks are submitted from a thread outside the pool.
+template<class Executor>
+void external(Executor ex, std::atomic<std::size_t>& count, std::size_t tasks)
+{
+  auto ex2 = execution::require(ex, execution::blocking.never);
+  for (std::size_t i = 0; i < tasks; ++i)
+    ex2.execute([&count]{ ++count; });
+}
+
+// A few root tasks each fork many small tasks from inside the pool.
+template<class Executor>
+void fork(Executor ex, std::atomic<std::size_t>& count, std::size_t tasks)
+{
+  auto ex2 = execution::require(ex, execution::blocking.never);
+  std::size_t roots = 16;
+  for (std::size_t r = 0; r < roots; ++r)
+  {
+    std::size_t children = tasks / roots + (r < tasks % roots ? 1 : 0);
+    ex2.execute([ex2, &count, children]
+        {
+          for (std::size_t i = 0; i < children; ++i)
+            ex2.execute([&count]{ ++count; });
+        });
+  }
+}
+
+// Chains of tasks, where each task submits its successor as a continuation.
+template<class Executor>
+struct chain_link
+{
+  Executor ex_;
+  std::atomic<std::size_t>* count_;
+  std::size_t remaining_;
+
+  void operator()() const
+  {
+    ++*count_;
+    if (remaining_ > 1)
+      ex_.execute(chain_link{ex_, count_, remaining_ - 1});
+  }
+};
+
+template<class Executor>
+void continuation(Executor ex, std::atomic<std::size_t>& count, std::size_t tasks)
+{
+  auto ex2 = execution::require(ex, execution::blocking.never, execution::relationship.continuation);
+  std::size_t chains = 64;
+  for (std::size_t c = 0; c < chains; ++c)
+    if (std::size_t length = tasks / chains + (c < tasks % chains ? 1 : 0))
+      ex2.execute(chain_link<decltype(ex2)>{ex2, &count, length});
+}
+
+// A single bulk submission from outside the pool.
+template<class Executor>
+void bulk(Executor ex, std::atomic<std::size_t>& count, std::size_t tasks)
+{
+  auto ex2 = execution::require(ex, execution::blocking.never);
+  ex2.bulk_execute([&count](std::size_t, int&){ ++count; }, tasks, []{ return 0; });
+}
+
+int main(int argc, char* argv[])
+{
+  std::size_t tasks = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 200000;
+  std::size_t threads = argc > 2 ? std::strtoul(argv[2], nullptr, 0) : std::max(1u, std::thread::hardware_concurrency());
+
+  std::cout << tasks << " tasks on " << threads << " threads\n";
+
+  const configuration configurations[] =
+  {
+    {"shared_queue", static_thread_pool::scheduling::shared_queue, false},
+    {"work_stealing", static_thread_pool::scheduling::work_stealing, false},
+    {"work_stealing+cont", static_thread_pool::scheduling::work_stealing, true}
+  };
+
+  for (const configuration& c : configurations)
+  {
+    run("external", c, threads, tasks, [](auto ex, auto& count, auto n){ external(ex, count, n); });
+    run("fork", c, threads, tasks, [](auto ex, auto& count, auto n){ fork(ex, count, n); });
+    run("continuation", c, threads, tasks, [](auto ex, auto& count, auto n){ continuation(ex, count, n); });
+    run("bulk", c, threads, tasks, [](auto ex, auto& count, auto n){ bulk(ex, count, n); });
+  }
+}
@@ -0,0 +1,76 @@
+#include <experimental/thread_pool>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace execution = std::experimental::execution;
+using std::experimental::static_thread_pool;
+
+// Measures the time from execute() to the start of the submitted function for
+// each idle policy. Functions are submitted at intervals, so that the pool's
+// threads have run out of work each time. Usage: latency [samples] [gap_us] [threads]
+
+using clock_type = std::chrono::steady_clock;
+
+struct configuration
+{
+  const char* name;
+  static_thread_pool::idle_policy idle;
+};
+
+void run(const configuration& c, std::size_t samples, std::chrono::microseconds gap, std::size_t threads)
+{
+  std::vector<clock_type::duration> latencies(samples);
+  {
+    static_thread_pool::options options;
+    options.idle = c.idle;
+    static_thread_pool pool{threads, options};
+    auto ex = execution::require(pool.executor(), execution::blocking.never);
+
+    for (std::size_t i = 0; i < samples; ++i)
+    {
+      std::this_thread::sleep_for(gap);
+      auto submitted = clock_type::now();
+      ex.execute([&latencies, i, submitted]{ latencies[i] = clock_type::now() - submitted; });
+    }
+
+    pool.wait();
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p)
+  {
+    auto d = latencies[std::min(samples - 1, static_cast<std::size_t>(p * samples))];
+    return std::chrono::duration<double, std::micro>(d).count();
+  };
+
+  std::cout << std::left << std::setw(16) << c.name << std::right << std::fixed << std::setprecision(1);
+  std::cout << "  p50 " << std::setw(8) << percentile(0.5) << " us";
+  std::cout << "  p99 " << std::setw(8) << percentile(0.99) << " us\n";
+}
+
+int main(int argc, char* argv[])
+{
+  std::size_t samples = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 2000;
+  std::chrono::microseconds gap(argc > 2 ? std::strtoul(argv[2], nullptr, 0) : 50);
+  std::size_t threads = argc > 3 ? std::strtoul(argv[3], nullptr, 0) : 1;
+
+  if (samples == 0)
+    return 0;
+
+  std::cout << samples << " samples, " << gap.count() << " us apart, on " << threads << " threads\n";
+
+  const configuration configurations[] =
+  {
+    {"park", {0, 0}},
+    {"yield", {0, 1000}},
+    {"spin", {100000, 0}},
+    {"spin+yield", {10000, 1000}}
+  };
+
+  for (const configuration& c : configurations)
+    run(c, samples, gap, threads);
+}
@@ -0,0 +1,62 @@
+#include <experimental/thread_pool>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+namespace execution = std::experimental::execution;
+using std::experimental::static_thread_pool;
+
+// Compares the cost of execute() on the pool's executor with the same call
+// made through the polymorphic executor, for a small function and for one
+// too large for the pool's recycled nodes. Usage: polymorphic [tasks] [threads]
+
+using polymorphic_executor = execution::executor<
+    execution::oneway_t,
+    execution::single_t,
+    execution::blocking_t::never_t
+  >;
+
+template<class Executor, class Function>
+void run(const char* name, const char* size, std::size_t threads, std::size_t tasks, Function f)
+{
+  std::atomic<std::size_t> count{0};
+  std::chrono::steady_clock::duration submit{};
+  auto start = std::chrono::steady_clock::now();
+  {
+    static_thread_pool pool{threads};
+    Executor ex = execution::require(pool.executor(), execution::blocking.never);
+    auto submit_start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < tasks; ++i)
+      ex.execute([&count, f]{ f(); ++count; });
+    submit = std::chrono::steady_clock::now() - submit_start;
+    pool.wait();
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << std::left << std::setw(14) << name << std::setw(8) << size << std::right << std::fixed;
+  std::cout << std::setw(10) << std::setprecision(1)
+    << std::chrono::duration<double, std::nano>(submit).count() / tasks << " ns/submit";
+  std::cout << std::setw(14) << std::setprecision(0) << count / elapsed << " tasks/s\n";
+}
+
+int main(int argc, char* argv[])
+{
+  std::size_t tasks = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 200000;
+  std::size_t threads = argc > 2 ? std::strtoul(argv[2], nullptr, 0) : std::max(1u, std::thread::hardware_concurrency());
+
+  std::cout << tasks << " tasks on " << threads << " threads\n";
+
+  using direct_executor = decltype(execution::require(std::declval<static_thread_pool::executor_type>(), execution::blocking.never));
+
+  auto small = []{};
+  auto large = [data = std::array<char, 256>{}]{ (void)data; };
+
+  run<direct_executor>("direct", "small", threads, tasks, small);
+  run<polymorphic_executor>("polymorphic", "small", threads, tasks, small);
+  run<direct_executor>("direct", "large", threads, tasks, large);
+  run<polymorphic_executor>("polymorphic", "large", threads, tasks, large);
+}
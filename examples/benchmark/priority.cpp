@@ -0,0 +1,88 @@
+#include <experimental/thread_pool>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace execution = std::experimental::execution;
+using std::experimental::static_thread_pool;
+
+// Measures the time from execute() to the start of a probe function while the
+// pool is saturated by a bulk batch job, with and without priorities. Usage:
+// priority [samples] [gap_us] [threads]
+
+using clock_type = std::chrono::steady_clock;
+using level = execution::priority_t::level;
+
+struct configuration
+{
+  const char* name;
+  level batch;
+  level probe;
+};
+
+void spin_for(std::chrono::microseconds d)
+{
+  for (auto end = clock_type::now() + d; clock_type::now() < end;) {}
+}
+
+void run(const configuration& c, std::size_t samples, std::chrono::microseconds gap, std::size_t threads)
+{
+  std::vector<clock_type::duration> latencies(samples);
+  {
+    static_thread_pool pool{threads};
+    auto ex = execution::require(pool.executor(), execution::blocking.never);
+
+    // Enough batch work to keep every thread busy for the whole run.
+    std::size_t batch_size = samples * (gap.count() / 10 + 1) * threads * 2;
+    execution::require(ex, execution::bulk, execution::priority(c.batch),
+        execution::bulk_chunk_size(1)).bulk_execute(
+          [](std::size_t, int&){ spin_for(std::chrono::microseconds(10)); }, batch_size, []{ return 0; });
+
+    auto probe_ex = execution::require(ex, execution::priority(c.probe));
+    for (std::size_t i = 0; i < samples; ++i)
+    {
+      std::this_thread::sleep_for(gap);
+      auto submitted = clock_type::now();
+      probe_ex.execute([&latencies, i, submitted]{ latencies[i] = clock_type::now() - submitted; });
+    }
+
+    pool.stop();
+    pool.wait();
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p)
+  {
+    auto d = latencies[std::min(samples - 1, static_cast<std::size_t>(p * samples))];
+    return std::chrono::duration<double, std::micro>(d).count();
+  };
+
+  std::cout << std::left << std::setw(28) << c.name << std::right << std::fixed << std::setprecision(1);
+  std::cout << "  p50 " << std::setw(10) << percentile(0.5) << " us";
+  std::cout << "  p99 " << std::setw(10) << percentile(0.99) << " us\n";
+}
+
+int main(int argc, char* argv[])
+{
+  std::size_t samples = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 200;
+  std::chrono::microseconds gap(argc > 2 ? std::strtoul(argv[2], nullptr, 0) : 500);
+  std::size_t threads = argc > 3 ? std::strtoul(argv[3], nullptr, 0) : std::max(1u, std::thread::hardware_concurrency());
+
+  if (samples == 0)
+    return 0;
+
+  std::cout << samples << " samples, " << gap.count() << " us apart, on " << threads << " threads\n";
+
+  const configuration configurations[] =
+  {
+    {"batch normal, probe normal", level::normal, level::normal},
+    {"batch low, probe normal", level::low, level::normal},
+    {"batch normal, probe high", level::normal, level::high}
+  };
+
+  for (const configuration& c : configurations)
+    run(c, samples, gap, threads);
+}
@@ -0,0 +1,67 @@
+#ifndef STD_EXPERIMENTAL_BITS_BULK_CHUNK_SIZE_H
+#define STD_EXPERIMENTAL_BITS_BULK_CHUNK_SIZE_H
+
+#include <cstddef>
+
+namespace std {
+namespace experimental {
+inline namespace executors_v1 {
+namespace execution {
+
+struct bulk_chunk_size_t
+{
+  static constexpr bool is_requirable = true;
+  static constexpr bool is_preferable = true;
+
+  using polymorphic_query_result_type = bulk_chunk_size_t;
+
+  template<class Executor, class Type = decltype(Executor::query(*static_cast<bulk_chunk_size_t*>(0)))>
+    static constexpr Type static_query_v = Executor::query(bulk_chunk_size_t());
+
+  // How a bulk shape is divided into chunks of contiguous indices.
+  enum class partitioning
+  {
+    static_, // Chunks are dealt out to execution agents in turn, in advance.
+    dynamic, // Chunks are claimed by execution agents as they become free.
+    guided   // As dynamic, but chunks shrink in proportion to the indices remaining.
+  };
+
+  // A size of zero lets the executor choose. For guided partitioning the size
+  // is the smallest chunk that will be claimed. By default the executor
+  // chooses, with guided partitioning; a size of 1 with dynamic partitioning
+  // claims each index separately.
+  constexpr bulk_chunk_size_t() = default;
+  constexpr explicit bulk_chunk_size_t(std::size_t size, partitioning p = partitioning::dynamic)
+    : size_(size), partitioning_(p) {}
+
+  constexpr bulk_chunk_size_t operator()(std::size_t size, partitioning p = partitioning::dynamic) const
+  {
+    return bulk_chunk_size_t(size, p);
+  }
+
+  constexpr std::size_t value() const { return size_; }
+  constexpr partitioning partition() const { return partitioning_; }
+
+  friend constexpr bool operator==(const bulk_chunk_size_t& a, const bulk_chunk_size_t& b) noexcept
+  {
+    return a.size_ == b.size_ && a.partitioning_ == b.partitioning_;
+  }
+
+  friend constexpr bool operator!=(const bulk_chunk_size_t& a, const bulk_chunk_size_t& b) noexcept
+  {
+    return !(a == b);
+  }
+
+private:
+  std::size_t size_ = 0;
+  partitioning partitioning_ = partitioning::guided;
+};
+
+constexpr bulk_chunk_size_t bulk_chunk_size;
+
+} // namespace execution
+} // inline namespace executors_v1
+} // namespace experimental
+} // namespace std
+
+#endif // STD_EXPERIMENTAL_BITS_BULK_CHUNK_SIZE_H
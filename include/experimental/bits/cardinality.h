@@ -1,7 +1,10 @@
 #ifndef STD_EXPERIMENTAL_BITS_CARDINALITY_H
 #define STD_EXPERIMENTAL_BITS_CARDINALITY_H
 
+#include <algorithm>
 #include <future>
+#include <thread>
+#include <experimental/bits/bulk_chunk_size.h>
 #include <experimental/bits/is_oneway_executor.h>
 #include <experimental/bits/is_twoway_executor.h>
 #include <experimental/bits/is_bulk_oneway_executor.h>
@@ -50,8 +53,24 @@ private:
     template <class T> static auto inner_declval() -> decltype(std::declval<Executor>());
     template <class, class T> struct dependent_type { using type = T; };
 
+    bulk_chunk_size_t chunk_;
+
   public:
     using impl::adapter<adapter, Executor>::adapter;
+    using impl::adapter<adapter, Executor>::require;
+    using impl::adapter<adapter, Executor>::query;
+
+    adapter require(const bulk_chunk_size_t& c) const
+    {
+      adapter a(*this);
+      a.chunk_ = c;
+      return a;
+    }
+
+    bulk_chunk_size_t query(const bulk_chunk_size_t&) const noexcept
+    {
+      return chunk_;
+    }
 
     template<class Function> auto execute(Function f) const
       -> decltype(inner_declval<Function>().execute(std::move(f)))
@@ -69,14 +88,30 @@ private:
     template<class Function, class SharedFactory>
     void bulk_execute(Function f, std::size_t n, SharedFactory sf) const
     {
-      auto shared_state = std::make_shared<decltype(sf())>(sf());
-      for (std::size_t i = 0; i < n; ++i)
+      // The function and shared state are shared by all chunks.
+      auto shared_state = std::make_shared<std::pair<Function, decltype(sf())>>(std::move(f), sf());
+
+      // Without knowledge of the underlying executor's concurrency, static and
+      // dynamic partitioning both submit one function per fixed size chunk.
+      std::size_t agents = std::max(1u, std::thread::hardware_concurrency());
+      std::size_t chunk_size = chunk_.value();
+      if (chunk_size == 0 && chunk_.partition() != bulk_chunk_size_t::partitioning::guided)
+        chunk_size = (n + agents - 1) / agents;
+      chunk_size = std::max<std::size_t>(chunk_size, 1);
+
+      for (std::size_t begin = 0; begin < n;)
       {
+        std::size_t size = chunk_size;
+        if (chunk_.partition() == bulk_chunk_size_t::partitioning::guided)
+          size = std::max(chunk_size, (n - begin) / (2 * agents));
+        std::size_t end = begin + std::min(size, n - begin);
         this->executor_.execute(
-            [f = std::move(f), i, shared_state]() mutable
+            [shared_state, begin, end]() mutable
             {
-              f(i, *shared_state);
+              for (std::size_t i = begin; i < end; ++i)
+                shared_state->first(i, shared_state->second);
             });
+        begin = end;
       }
     }
 
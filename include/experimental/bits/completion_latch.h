@@ -0,0 +1,69 @@
+#ifndef STD_EXPERIMENTAL_BITS_COMPLETION_LATCH_H
+#define STD_EXPERIMENTAL_BITS_COMPLETION_LATCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <experimental/bits/futex.h>
+
+namespace std {
+namespace experimental {
+inline namespace executors_v1 {
+namespace thread_pool_impl {
+
+// Completion signal for always-blocking submission. Lives on the waiting
+// thread's stack, so signalling it needs no allocation.
+class completion_latch
+{
+public:
+  completion_latch() = default;
+  completion_latch(const completion_latch&) = delete;
+  completion_latch& operator=(const completion_latch&) = delete;
+
+  // Counts down the latch when destroyed, whether or not the owning function
+  // was run. Only the first destructor of a moved-from chain signals.
+  class guard
+  {
+  public:
+    explicit guard(completion_latch* latch) noexcept : latch_(latch) {}
+    guard(guard&& other) noexcept : latch_(std::exchange(other.latch_, nullptr)) {}
+    guard& operator=(guard&&) = delete;
+    ~guard() { if (latch_) latch_->count_down(); }
+
+  private:
+    completion_latch* latch_;
+  };
+
+  void count_down() noexcept
+  {
+    // Only the word's address is used once it is marked done, as the waiter
+    // may then destroy the latch. A wake that finds nobody there is harmless.
+    if (state_.exchange(done, std::memory_order_acq_rel) == waiting)
+      futex_impl::wake_all(state_);
+  }
+
+  void wait() noexcept
+  {
+    std::uint32_t s = pending;
+    if (state_.compare_exchange_strong(s, waiting, std::memory_order_acquire))
+      s = waiting;
+    while (s != done)
+    {
+      futex_impl::wait(state_, waiting);
+      s = state_.load(std::memory_order_acquire);
+    }
+  }
+
+private:
+  static constexpr std::uint32_t pending = 0;
+  static constexpr std::uint32_t waiting = 1;
+  static constexpr std::uint32_t done = 2;
+  std::atomic<std::uint32_t> state_{pending};
+};
+
+} // namespace thread_pool_impl
+} // inline namespace executors_v1
+} // namespace experimental
+} // namespace std
+
+#endif // STD_EXPERIMENTAL_BITS_COMPLETION_LATCH_H
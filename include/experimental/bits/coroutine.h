@@ -0,0 +1,430 @@
+#ifndef STD_EXPERIMENTAL_BITS_COROUTINE_H
+#define STD_EXPERIMENTAL_BITS_COROUTINE_H
+
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace std {
+namespace experimental {
+inline namespace executors_v1 {
+namespace future_impl {
+
+// Allocates coroutine frames. A copy of the allocator, and the function that
+// frees the frame with it, are stored after the frame.
+class frame_allocator
+{
+  using block = std::max_align_t;
+  using deallocate_fn = void (*)(void*, std::size_t);
+
+  static constexpr std::size_t blocks(std::size_t size) noexcept
+  {
+    return (size + sizeof(block) - 1) / sizeof(block);
+  }
+
+  template<class Allocator>
+  static constexpr std::size_t total_blocks(std::size_t size) noexcept
+  {
+    return blocks(size) + blocks(sizeof(deallocate_fn)) + blocks(sizeof(Allocator));
+  }
+
+  template<class Allocator>
+  static void deallocate(void* frame, std::size_t size) noexcept
+  {
+    block* p = static_cast<block*>(frame);
+    Allocator* a = std::launder(reinterpret_cast<Allocator*>(p + blocks(size) + blocks(sizeof(deallocate_fn))));
+    Allocator alloc(std::move(*a));
+    a->~Allocator();
+    std::allocator_traits<Allocator>::deallocate(alloc, p, total_blocks<Allocator>(size));
+  }
+
+public:
+  template<class ProtoAllocator>
+  static void* allocate(std::size_t size, const ProtoAllocator& a)
+  {
+    using allocator_type = typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<block>;
+    static_assert(alignof(allocator_type) <= alignof(block), "allocator is over-aligned");
+    allocator_type alloc(a);
+    block* p = std::allocator_traits<allocator_type>::allocate(alloc, total_blocks<allocator_type>(size));
+    new (p + blocks(size)) deallocate_fn(&deallocate<allocator_type>);
+    new (p + blocks(size) + blocks(sizeof(deallocate_fn))) allocator_type(std::move(alloc));
+    return p;
+  }
+
+  static void deallocate(void* frame, std::size_t size) noexcept
+  {
+    block* p = static_cast<block*>(frame);
+    (*std::launder(reinterpret_cast<deallocate_fn*>(p + blocks(size))))(frame, size);
+  }
+};
+
+// The allocation functions of a coroutine with the given parameter types. They
+// are not templates, so that GCC pairs them when checking for mismatched new
+// and delete.
+template<class Enable, class... Args>
+class frame_allocation_impl
+{
+public:
+  static void* operator new(std::size_t size)
+  {
+    return frame_allocator::allocate(size, std::allocator<void>());
+  }
+
+  static void operator delete(void* frame, std::size_t size) noexcept
+  {
+    frame_allocator::deallocate(frame, size);
+  }
+};
+
+// If the coroutine's first parameter is an executor with an allocator
+// property, the frame comes from that allocator.
+template<class Executor, class... Args>
+class frame_allocation_impl<
+  typename std::enable_if<
+    execution::can_query<typename std::decay<Executor>::type, execution::allocator_t<void>>::value>::type,
+  Executor, Args...>
+{
+public:
+  static void* operator new(std::size_t size, const typename std::remove_reference<Executor>::type& ex,
+      const typename std::remove_reference<Args>::type&...)
+  {
+    return frame_allocator::allocate(size, execution::query(ex, execution::allocator));
+  }
+
+  static void operator delete(void* frame, std::size_t size) noexcept
+  {
+    frame_allocator::deallocate(frame, size);
+  }
+};
+
+template<class... Args>
+using frame_allocation = frame_allocation_impl<void, Args...>;
+
+template<class R>
+class task_promise_result
+{
+public:
+  template<class V>
+  void return_value(V&& v)
+  {
+    value_.emplace(std::forward<V>(v));
+  }
+
+protected:
+  R take() { return std::move(*value_); }
+
+private:
+  std::optional<R> value_;
+};
+
+template<>
+class task_promise_result<void>
+{
+public:
+  void return_void() noexcept {}
+
+protected:
+  void take() noexcept {}
+};
+
+// The part of a task's promise that does not depend on the coroutine's
+// parameters, through which the task collects the result.
+template<class R>
+class task_promise : public task_promise_result<R>
+{
+public:
+  std::suspend_always initial_suspend() noexcept { return {}; }
+
+  // Transfers control to the awaiting coroutine, if any.
+  auto final_suspend() noexcept
+  {
+    struct awaiter
+    {
+      task_promise* promise_;
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept
+      {
+        if (std::coroutine_handle<> c = promise_->continuation_)
+          return c;
+        return std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+    return awaiter{this};
+  }
+
+  void unhandled_exception() noexcept
+  {
+    exception_ = std::current_exception();
+  }
+
+  R result()
+  {
+    if (exception_)
+      std::rethrow_exception(exception_);
+    return this->take();
+  }
+
+private:
+  template<class> friend class ::std::experimental::executors_v1::task;
+  std::coroutine_handle<> continuation_;
+  std::exception_ptr exception_;
+};
+
+// Promise of a task coroutine with the given parameter types.
+template<class R, class... Args>
+class task_frame_promise : public task_promise<R>, public frame_allocation<Args...>
+{
+public:
+  task<R> get_return_object() noexcept;
+};
+
+// Promise of a coroutine returning future<R>, which runs eagerly.
+template<class R, class... Args>
+class future_promise_base : public frame_allocation<Args...>
+{
+public:
+  future<R> get_return_object() { return promise_.get_future(); }
+  std::suspend_never initial_suspend() noexcept { return {}; }
+  std::suspend_never final_suspend() noexcept { return {}; }
+  void unhandled_exception() { promise_.set_exception(std::current_exception()); }
+
+protected:
+  promise<R> promise_;
+};
+
+template<class R, class... Args>
+class future_promise : public future_promise_base<R, Args...>
+{
+public:
+  template<class V>
+  void return_value(V&& v)
+  {
+    this->promise_.set_value(std::forward<V>(v));
+  }
+};
+
+template<class... Args>
+class future_promise<void, Args...> : public future_promise_base<void, Args...>
+{
+public:
+  void return_void()
+  {
+    this->promise_.set_value();
+  }
+};
+
+// Awaits a future, resuming the coroutine through the executor once the
+// future is ready, as then() would run a continuation. The awaiter is itself
+// the continuation, so awaiting does not allocate. A coroutine suspended on a
+// future that is not ready may be destroyed, and the awaiter detaches from the
+// future. Once the future is ready, or while another thread makes it ready,
+// the coroutine belongs to its pending resumption, and destroying it is
+// undefined behaviour.
+template<class R, class Executor>
+class future_awaiter : private continuation_base
+{
+public:
+  future_awaiter(future<R> f, Executor ex) : future_(std::move(f)), executor_(std::move(ex)) {}
+
+  future_awaiter(const future_awaiter&) = delete;
+  future_awaiter& operator=(const future_awaiter&) = delete;
+
+  ~future_awaiter()
+  {
+    // The state is released once the coroutine has been resumed.
+    if (attached_ && future_.state_)
+      future_.state_->try_detach(this);
+  }
+
+  bool await_ready() const noexcept
+  {
+    return !future_.state_ || future_.state_->is_ready();
+  }
+
+  bool await_suspend(std::coroutine_handle<> h)
+  {
+    handle_ = h;
+    if (future_.state_->try_attach(this))
+    {
+      attached_ = true;
+      return true;
+    }
+
+    // Ready since await_ready(), so resume as a nested then() would.
+    if (std::is_same<Executor, default_executor>::value)
+      return false;
+    executor_.execute([h]{ h.resume(); });
+    return true;
+  }
+
+  R await_resume()
+  {
+    return future_.get();
+  }
+
+private:
+  // The coroutine may finish, destroying this awaiter, as soon as it is resumed.
+  void run(bool) override
+  {
+    std::coroutine_handle<> h = handle_;
+    Executor ex(executor_);
+    execution::prefer(ex, execution::blocking.possibly).execute([h]{ h.resume(); });
+  }
+
+  // The awaiter holds a reference to the state, so it detaches before the
+  // state can be destroyed.
+  void discard() noexcept override
+  {
+  }
+
+  future<R> future_;
+  Executor executor_;
+  std::coroutine_handle<> handle_;
+  bool attached_ = false;
+};
+
+template<class Executor>
+class schedule_awaiter
+{
+public:
+  explicit schedule_awaiter(Executor ex) : executor_(std::move(ex)) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> h)
+  {
+    Executor ex(executor_);
+    ex.execute([h]{ h.resume(); });
+  }
+
+  void await_resume() const noexcept {}
+
+private:
+  Executor executor_;
+};
+
+} // namespace future_impl
+} // inline namespace executors_v1
+} // namespace experimental
+
+// A coroutine returning future<R> runs eagerly, and its result makes the
+// future ready.
+template<class R, class... Args>
+struct coroutine_traits<experimental::executors_v1::future<R>, Args...>
+{
+  using promise_type = experimental::executors_v1::future_impl::future_promise<R, Args...>;
+};
+
+template<class R, class... Args>
+struct coroutine_traits<experimental::executors_v1::task<R>, Args...>
+{
+  using promise_type = experimental::executors_v1::future_impl::task_frame_promise<R, Args...>;
+};
+
+namespace experimental {
+inline namespace executors_v1 {
+
+// A lazily started coroutine, which runs when awaited and returns its result
+// to the awaiting coroutine.
+template<class R>
+class task
+{
+public:
+  task(task&& other) noexcept
+    : handle_(std::exchange(other.handle_, nullptr)), promise_(std::exchange(other.promise_, nullptr)) {}
+  task(const task&) = delete;
+  task& operator=(task other) noexcept
+  {
+    std::swap(handle_, other.handle_);
+    std::swap(promise_, other.promise_);
+    return *this;
+  }
+
+  ~task()
+  {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  auto operator co_await() && noexcept
+  {
+    struct awaiter
+    {
+      std::coroutine_handle<> handle_;
+      future_impl::task_promise<R>* promise_;
+      bool await_ready() const noexcept { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept
+      {
+        promise_->continuation_ = h;
+        return handle_;
+      }
+      R await_resume() { return promise_->result(); }
+    };
+    return awaiter{handle_, promise_};
+  }
+
+private:
+  template<class, class...> friend class future_impl::task_frame_promise;
+  task(std::coroutine_handle<> h, future_impl::task_promise<R>& p) noexcept : handle_(h), promise_(&p) {}
+  std::coroutine_handle<> handle_;
+  future_impl::task_promise<R>* promise_ = nullptr;
+};
+
+template<class R, class... Args>
+inline task<R> future_impl::task_frame_promise<R, Args...>::get_return_object() noexcept
+{
+  return task<R>(std::coroutine_handle<task_frame_promise>::from_promise(*this), *this);
+}
+
+// Runs a task on the calling thread until it first suspends. The returned
+// future receives its result.
+template<class R>
+future<R> spawn(task<R> t)
+{
+  co_return co_await std::move(t);
+}
+
+inline future<void> spawn(task<void> t)
+{
+  co_await std::move(t);
+}
+
+// Awaiting a future resumes the coroutine on the thread that makes it ready.
+template<class R>
+inline auto operator co_await(future<R>&& f)
+{
+  return future_impl::future_awaiter<R, future_impl::default_executor>(std::move(f), future_impl::default_executor());
+}
+
+// Awaits a future, resuming the coroutine through the executor.
+template<class Executor, class R>
+inline auto resume_on(const Executor& ex, future<R> f)
+{
+  using executor_type = decltype(execution::require(ex, execution::oneway));
+  return future_impl::future_awaiter<R, executor_type>(std::move(f), execution::require(ex, execution::oneway));
+}
+
+// Resumes the awaiting coroutine on an execution agent of the executor.
+template<class Executor>
+inline auto schedule(const Executor& ex)
+{
+  auto ex2 = execution::require(execution::prefer(ex, execution::blocking.never), execution::oneway);
+  return future_impl::schedule_awaiter<decltype(ex2)>(std::move(ex2));
+}
+
+} // inline namespace executors_v1
+} // namespace experimental
+
+} // namespace std
+
+#endif // defined(__cpp_impl_coroutine)
+
+#endif // STD_EXPERIMENTAL_BITS_COROUTINE_H
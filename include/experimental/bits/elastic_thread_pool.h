@@ -0,0 +1,661 @@
+#ifndef STD_EXPERIMENTAL_BITS_ELASTIC_THREAD_POOL_H
+#define STD_EXPERIMENTAL_BITS_ELASTIC_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <experimental/future>
+#include <experimental/bits/completion_latch.h>
+#include <experimental/bits/erased_function.h>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+namespace std {
+namespace experimental {
+inline namespace executors_v1 {
+
+// A thread pool whose thread count follows demand. A thread is added whenever
+// a function is submitted while every thread is busy, such as when functions
+// block, and threads above the minimum retire after an idle timeout.
+class elastic_thread_pool
+{
+  template<class Blocking, class Continuation, class Work, class ProtoAllocator>
+  class executor_impl
+  {
+    friend class elastic_thread_pool;
+    elastic_thread_pool* pool_;
+    ProtoAllocator allocator_;
+    execution::bulk_chunk_size_t chunk_;
+
+    executor_impl(elastic_thread_pool* p, const ProtoAllocator& a, const execution::bulk_chunk_size_t& c) noexcept
+      : pool_(p), allocator_(a), chunk_(c) { pool_->work_up(Work{}); }
+
+  public:
+    using shape_type = std::size_t;
+
+    executor_impl(const executor_impl& other) noexcept
+      : pool_(other.pool_), allocator_(other.allocator_), chunk_(other.chunk_) { pool_->work_up(Work{}); }
+    ~executor_impl() { pool_->work_down(Work{}); }
+
+    // Associated execution context.
+    elastic_thread_pool& query(execution::context_t) const noexcept { return *pool_; }
+
+    // Blocking modes.
+    executor_impl<execution::blocking_t::never_t, Continuation, Work, ProtoAllocator>
+      require(execution::blocking_t::never_t) const { return {pool_, allocator_, chunk_}; };
+    executor_impl<execution::blocking_t::possibly_t, Continuation, Work, ProtoAllocator>
+      require(execution::blocking_t::possibly_t) const { return {pool_, allocator_, chunk_}; };
+    executor_impl<execution::blocking_t::always_t, Continuation, Work, ProtoAllocator>
+      require(execution::blocking_t::always_t) const { return {pool_, allocator_, chunk_}; };
+    static constexpr execution::blocking_t query(execution::blocking_t) { return Blocking{}; }
+
+    // Continuation hint.
+    executor_impl<Blocking, execution::relationship_t::fork_t, Work, ProtoAllocator>
+      require(execution::relationship_t::fork_t) const { return {pool_, allocator_, chunk_}; };
+    executor_impl<Blocking, execution::relationship_t::continuation_t, Work, ProtoAllocator>
+      require(execution::relationship_t::continuation_t) const { return {pool_, allocator_, chunk_}; };
+    static constexpr execution::relationship_t query(execution::relationship_t) { return Continuation{}; }
+
+    // Work tracking.
+    executor_impl<Blocking, Continuation, execution::outstanding_work_t::untracked_t, ProtoAllocator>
+      require(execution::outstanding_work_t::untracked_t) const { return {pool_, allocator_, chunk_}; };
+    executor_impl<Blocking, Continuation, execution::outstanding_work_t::tracked_t, ProtoAllocator>
+      require(execution::outstanding_work_t::tracked_t) const { return {pool_, allocator_, chunk_}; };
+    static constexpr execution::outstanding_work_t query(execution::outstanding_work_t) { return Work{}; }
+
+    // Bulk forward progress.
+    static constexpr execution::bulk_guarantee_t query(execution::bulk_guarantee_t) { return execution::bulk_guarantee.parallel; }
+
+    // Mapping of execution on to threads.
+    static constexpr execution::mapping_t query(execution::mapping_t) { return execution::mapping.thread; }
+
+    // Allocator.
+    executor_impl<Blocking, Continuation, Work, std::allocator<void>>
+      require(const execution::allocator_t<void>&) const { return {pool_, std::allocator<void>{}, chunk_}; };
+    template<class NewProtoAllocator>
+      executor_impl<Blocking, Continuation, Work, NewProtoAllocator>
+        require(const execution::allocator_t<NewProtoAllocator>& a) const { return {pool_, a.value(), chunk_}; }
+    ProtoAllocator query(const execution::allocator_t<ProtoAllocator>&) const noexcept { return allocator_; }
+    ProtoAllocator query(const execution::allocator_t<void>&) const noexcept { return allocator_; }
+
+    // Partitioning of bulk shapes.
+    executor_impl require(const execution::bulk_chunk_size_t& c) const { return {pool_, allocator_, c}; }
+    execution::bulk_chunk_size_t query(const execution::bulk_chunk_size_t&) const noexcept { return chunk_; }
+
+    // Live thread counts.
+    std::size_t query(execution::thread_count_t) const noexcept { return pool_->owned_ + pool_->attached_; }
+    std::size_t query(execution::idle_thread_count_t) const noexcept { return pool_->idle_; }
+
+    bool running_in_this_thread() const noexcept { return pool_->running_in_this_thread(); }
+
+    friend bool operator==(const executor_impl& a, const executor_impl& b) noexcept
+    {
+      return a.pool_ == b.pool_;
+    }
+
+    friend bool operator!=(const executor_impl& a, const executor_impl& b) noexcept
+    {
+      return a.pool_ != b.pool_;
+    }
+
+    template<class Function> void execute(Function f) const
+    {
+      pool_->execute(Blocking{}, allocator_, std::move(f));
+    }
+
+    // Submits a function on behalf of the polymorphic executor.
+    void execute_erased(const execution::executor_impl::erased_function& f) const
+    {
+      pool_->execute_erased(Blocking{}, allocator_, f);
+    }
+
+    template<class Function> auto twoway_execute(Function f) const -> future<decltype(f())>
+    {
+      return pool_->twoway_execute(Blocking{}, allocator_, std::move(f));
+    }
+
+    template<class Function, class SharedFactory> void bulk_execute(Function f, std::size_t n, SharedFactory sf) const
+    {
+      pool_->bulk_execute(Blocking{}, allocator_, chunk_, std::move(f), n, std::move(sf));
+    }
+  };
+
+public:
+  using executor_type = executor_impl<
+      execution::blocking_t::possibly_t,
+      execution::relationship_t::fork_t,
+      execution::outstanding_work_t::untracked_t,
+      std::allocator<void>
+    >;
+
+  // Limits on the pool's own threads. Threads that call attach() are not counted.
+  struct options
+  {
+    // Threads that are started with the pool and are never retired.
+    std::size_t min_threads = 0;
+
+    // Threads are not added beyond this number, even if all are blocked.
+    std::size_t max_threads = 64;
+
+    // How long a thread above the minimum waits for work before it retires.
+    std::chrono::steady_clock::duration idle_timeout = std::chrono::seconds(1);
+  };
+
+  elastic_thread_pool(std::size_t min_threads, std::size_t max_threads)
+    : elastic_thread_pool([=]{ options o; o.min_threads = min_threads; o.max_threads = max_threads; return o; }())
+  {
+  }
+
+  explicit elastic_thread_pool(const options& o)
+    : options_(o)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (owned_ < options_.min_threads)
+      spawn();
+  }
+
+  elastic_thread_pool(const elastic_thread_pool&) = delete;
+  elastic_thread_pool& operator=(const elastic_thread_pool&) = delete;
+
+  ~elastic_thread_pool()
+  {
+    stop();
+    wait();
+    while (func_base* func = pop())
+      func->destroy();
+  }
+
+  executor_type executor() noexcept
+  {
+    return executor_type{this, std::allocator<void>{}, execution::bulk_chunk_size_t{}};
+  }
+
+  void attach()
+  {
+    ++attached_;
+    run(nullptr);
+    --attached_;
+  }
+
+  void stop()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopped_ = true;
+    condition_.notify_all();
+  }
+
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!waited_)
+    {
+      waited_ = true;
+      --work_;
+      condition_.notify_all();
+    }
+
+    // Threads may still be added while the remaining functions run.
+    while (!threads_.empty())
+    {
+      std::list<worker> threads;
+      threads.splice(threads.end(), threads_);
+      lock.unlock();
+      for (auto& w : threads)
+        w.thread_.join();
+      lock.lock();
+    }
+  }
+
+private:
+  template<class Function>
+  static void invoke(Function& f) noexcept // Exceptions mean std::terminate.
+  {
+    f();
+  }
+
+  struct func_base
+  {
+    virtual ~func_base() {}
+    virtual void call() = 0;
+    virtual void destroy() = 0;
+
+    func_base* next_{nullptr};
+  };
+
+  template<class Function, class ProtoAllocator>
+  struct func : func_base
+  {
+    using allocator_type = typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<func>;
+
+    explicit func(Function f, const ProtoAllocator& a) : function_(std::move(f)), allocator_(a) {}
+
+    static func_base* create(Function f, const ProtoAllocator& a)
+    {
+      allocator_type allocator(a);
+      func* raw_p = allocator.allocate(1);
+      try
+      {
+        return new (raw_p) func(std::move(f), a);
+      }
+      catch (...)
+      {
+        allocator.deallocate(raw_p, 1);
+        throw;
+      }
+    }
+
+    virtual void call()
+    {
+      Function f(std::move(function_));
+      destroy();
+      elastic_thread_pool::invoke(f);
+    }
+
+    virtual void destroy()
+    {
+      func* p = this;
+      allocator_type allocator(std::move(allocator_));
+      p->~func();
+      allocator.deallocate(p, 1);
+    }
+
+    Function function_;
+    allocator_type allocator_;
+  };
+
+  // A function whose type was erased by the polymorphic executor, moved into
+  // the same allocation as its node.
+  template<class ProtoAllocator>
+  struct erased_func : func_base
+  {
+    using block = std::max_align_t;
+    using allocator_type = typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<block>;
+
+    erased_func(const execution::executor_impl::erased_function& f, void* storage,
+        const ProtoAllocator& a, std::size_t blocks)
+      : function_(f.move_to(storage)), allocator_(a), blocks_(blocks) {}
+
+    static func_base* create(const execution::executor_impl::erased_function& f, const ProtoAllocator& a)
+    {
+      std::size_t blocks = (f.size_after(sizeof(erased_func)) + sizeof(block) - 1) / sizeof(block);
+      allocator_type allocator(a);
+      block* raw_p = allocator.allocate(blocks);
+      try
+      {
+        return new (raw_p) erased_func(f, f.address_after(raw_p, sizeof(erased_func)), a, blocks);
+      }
+      catch (...)
+      {
+        allocator.deallocate(raw_p, blocks);
+        throw;
+      }
+    }
+
+    virtual void call()
+    {
+      struct guard { erased_func* p; ~guard() { p->destroy(); } } g{this};
+      elastic_thread_pool::invoke(function_);
+    }
+
+    virtual void destroy()
+    {
+      function_.destroy();
+      allocator_type allocator(std::move(allocator_));
+      std::size_t blocks = blocks_;
+      this->~erased_func();
+      allocator.deallocate(reinterpret_cast<block*>(this), blocks);
+    }
+
+    execution::executor_impl::erased_function function_;
+    allocator_type allocator_;
+    std::size_t blocks_;
+  };
+
+  // A thread owned by the pool.
+  struct worker
+  {
+    std::thread thread_;
+    bool exited_{false}; // Protected by mutex_.
+  };
+
+  struct thread_private_state
+  {
+    elastic_thread_pool* pool_;
+    thread_private_state* prev_state_{instance()};
+
+    explicit thread_private_state(elastic_thread_pool* p) : pool_(p) { instance() = this; }
+    ~thread_private_state() { instance() = prev_state_; }
+
+    static thread_private_state*& instance()
+    {
+      static thread_local thread_private_state* p;
+      return p;
+    }
+  };
+
+  bool running_in_this_thread() const noexcept
+  {
+    if (thread_private_state* private_state = thread_private_state::instance())
+      if (private_state->pool_ == this)
+        return true;
+    return false;
+  }
+
+  template<class Blocking, class ProtoAllocator, class Function>
+  void execute(Blocking, const ProtoAllocator& alloc, Function f)
+  {
+    if (std::is_same<Blocking, execution::blocking_t::possibly_t>::value)
+    {
+      // Run immediately if already in the pool.
+      if (running_in_this_thread())
+      {
+        elastic_thread_pool::invoke(f);
+        return;
+      }
+    }
+
+    enqueue(func<Function, ProtoAllocator>::create(std::move(f), alloc));
+  }
+
+  template<class ProtoAllocator, class Function>
+  void execute(execution::blocking_t::always_t, const ProtoAllocator& alloc, Function f)
+  {
+    // Run immediately if already in the pool.
+    if (running_in_this_thread())
+    {
+      elastic_thread_pool::invoke(f);
+      return;
+    }
+
+    // Otherwise, wrap the function with a guard that, when destroyed, will signal that the function is complete.
+    thread_pool_impl::completion_latch latch;
+    this->execute(execution::blocking.never, alloc,
+        [f = std::move(f), g = thread_pool_impl::completion_latch::guard(&latch)]() mutable { f(); });
+    latch.wait();
+  }
+
+  // The function is moved into a queued node only if it cannot run at once.
+  template<class Blocking, class ProtoAllocator>
+  void execute_erased(Blocking, const ProtoAllocator& alloc, const execution::executor_impl::erased_function& f)
+  {
+    if (std::is_same<Blocking, execution::blocking_t::possibly_t>::value)
+    {
+      // Run immediately if already in the pool.
+      if (running_in_this_thread())
+      {
+        elastic_thread_pool::invoke(f);
+        return;
+      }
+    }
+
+    enqueue(erased_func<ProtoAllocator>::create(f, alloc));
+  }
+
+  // The caller's function outlives the wait, so it is run by reference.
+  template<class ProtoAllocator>
+  void execute_erased(execution::blocking_t::always_t, const ProtoAllocator& alloc,
+      const execution::executor_impl::erased_function& f)
+  {
+    this->execute(execution::blocking.always, alloc, [&f]{ f(); });
+  }
+
+  template<class Blocking, class ProtoAllocator, class Function>
+  auto twoway_execute(Blocking, const ProtoAllocator& alloc, Function f) -> future<decltype(f())>
+  {
+    packaged_task<decltype(f())()> task(std::allocator_arg, alloc, std::move(f));
+    future<decltype(f())> future = task.get_future();
+    this->execute(Blocking{}, alloc, std::move(task));
+    return future;
+  }
+
+  template<class Function, class SharedFactory>
+  struct bulk_state
+  {
+    using partitioning = execution::bulk_chunk_size_t::partitioning;
+
+    Function f_;
+    decltype(std::declval<SharedFactory>()()) ss_;
+    std::size_t n_;
+    partitioning partitioning_;
+    std::size_t chunk_size_;
+    std::size_t descriptors_;
+    std::atomic<std::size_t> next_{0};
+
+    bulk_state(Function f, std::size_t n, SharedFactory sf, partitioning p, std::size_t chunk_size, std::size_t descriptors)
+      : f_(std::move(f)), ss_(sf()), n_(n), partitioning_(p), chunk_size_(chunk_size), descriptors_(descriptors) {}
+
+    // Runs the chunks assigned to, or claimed by, a descriptor. With static
+    // partitioning, position is the start of the descriptor's first chunk.
+    void operator()(std::size_t position)
+    {
+      switch (partitioning_)
+      {
+      case partitioning::static_:
+        for (; position < n_; position += descriptors_ * chunk_size_)
+          run(position, position + std::min(chunk_size_, n_ - position));
+        break;
+      case partitioning::dynamic:
+        for (std::size_t begin; (begin = next_.fetch_add(chunk_size_, std::memory_order_relaxed)) < n_;)
+          run(begin, begin + std::min(chunk_size_, n_ - begin));
+        break;
+      case partitioning::guided:
+        for (std::size_t begin = next_.load(std::memory_order_relaxed); begin < n_;)
+        {
+          std::size_t size = std::max(chunk_size_, (n_ - begin) / (2 * descriptors_));
+          std::size_t end = begin + std::min(size, n_ - begin);
+          if (next_.compare_exchange_weak(begin, end, std::memory_order_relaxed))
+          {
+            run(begin, end);
+            begin = next_.load(std::memory_order_relaxed);
+          }
+        }
+        break;
+      }
+    }
+
+    void run(std::size_t begin, std::size_t end)
+    {
+      for (std::size_t i = begin; i < end; ++i)
+        f_(i, ss_);
+    }
+  };
+
+  template<class Blocking, class ProtoAllocator, class Function, class SharedFactory>
+  void bulk_execute(Blocking, const ProtoAllocator& alloc, const execution::bulk_chunk_size_t& chunk,
+      Function f, std::size_t n, SharedFactory sf)
+  {
+    using partitioning = execution::bulk_chunk_size_t::partitioning;
+
+    // Submit one function per thread that could usefully run at once, each of
+    // which runs chunks of indices until none remain. Blocking in a bulk
+    // function adds threads in the same way as for single functions.
+    std::size_t threads = std::max<std::size_t>({owned_ + attached_,
+        std::min<std::size_t>(options_.max_threads, std::thread::hardware_concurrency()), 1});
+    std::size_t chunk_size = chunk.value();
+    if (chunk_size == 0)
+    {
+      if (chunk.partition() == partitioning::static_)
+        chunk_size = (n + threads - 1) / threads;
+      else if (chunk.partition() == partitioning::dynamic)
+        chunk_size = n / (threads * 8);
+      chunk_size = std::max<std::size_t>(chunk_size, 1);
+    }
+    std::size_t chunks = chunk.partition() == partitioning::guided ? n : (n + chunk_size - 1) / chunk_size;
+    std::size_t descriptors = std::min(chunks, threads);
+
+    typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<char> alloc2(alloc);
+    auto shared_state = std::allocate_shared<bulk_state<Function, SharedFactory>>(
+        alloc2, std::move(f), n, std::move(sf), chunk.partition(), chunk_size, descriptors);
+
+    for (std::size_t i = 0; i < descriptors; ++i)
+    {
+      auto descriptor = [shared_state, position = i * chunk_size]{ (*shared_state)(position); };
+      enqueue(func<decltype(descriptor), ProtoAllocator>::create(std::move(descriptor), alloc));
+    }
+  }
+
+  template<class ProtoAllocator, class Function, class SharedFactory>
+  void bulk_execute(execution::blocking_t::always_t, const ProtoAllocator& alloc, const execution::bulk_chunk_size_t& chunk,
+      Function f, std::size_t n, SharedFactory sf)
+  {
+    // Wrap the function with a guard that, when the shared state is destroyed, will signal that all indices are complete.
+    thread_pool_impl::completion_latch latch;
+    auto wrapped_f = [f = std::move(f), g = thread_pool_impl::completion_latch::guard(&latch)](std::size_t n, auto& s) mutable { f(n, s); };
+    this->bulk_execute(execution::blocking.never, alloc, chunk, std::move(wrapped_f), n, std::move(sf));
+    latch.wait();
+  }
+
+  void enqueue(func_base* func)
+  {
+    std::list<worker> exited;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      *tail_ = func;
+      tail_ = &func->next_;
+      ++queued_;
+
+      // Add a thread if there are more queued functions than idle threads to
+      // claim them. Failure to start one leaves the function to existing threads.
+      if (queued_ > idle_ && owned_ < options_.max_threads && !stopped_)
+      {
+        reap(exited);
+        try
+        {
+          spawn();
+        }
+        catch (...)
+        {
+        }
+      }
+
+      if (idle_ != 0)
+        condition_.notify_one();
+    }
+
+    for (auto& w : exited)
+      w.thread_.join();
+  }
+
+  // Requires mutex_.
+  func_base* pop() noexcept
+  {
+    func_base* func = head_;
+    if (func)
+    {
+      head_ = func->next_;
+      if (!head_)
+        tail_ = &head_;
+      func->next_ = nullptr;
+      --queued_;
+    }
+    return func;
+  }
+
+  // Starts a thread owned by the pool. Requires mutex_.
+  void spawn()
+  {
+    worker& w = *threads_.emplace(threads_.end());
+    try
+    {
+      w.thread_ = std::thread([this, &w]{ run(&w); });
+    }
+    catch (...)
+    {
+      threads_.pop_back();
+      throw;
+    }
+    ++owned_;
+  }
+
+  // Moves the threads that have retired out of threads_, so they may be
+  // joined after releasing mutex_. Requires mutex_.
+  void reap(std::list<worker>& exited)
+  {
+    for (auto w = threads_.begin(); w != threads_.end();)
+    {
+      auto next = std::next(w);
+      if (w->exited_)
+        exited.splice(exited.end(), threads_, w);
+      w = next;
+    }
+  }
+
+  // Runs functions until the pool stops or runs out of work. Threads owned by
+  // the pool also return after idling beyond the timeout, if above the minimum.
+  void run(worker* owner)
+  {
+    thread_private_state private_state{this};
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopped_)
+    {
+      if (func_base* func = pop())
+      {
+        lock.unlock();
+        func->call();
+        lock.lock();
+        continue;
+      }
+
+      if (work_ == 0)
+        break;
+
+      ++idle_;
+      bool timed_out = condition_.wait_for(lock, options_.idle_timeout) == std::cv_status::timeout;
+      --idle_;
+
+      if (owner && timed_out && !head_ && owned_ > options_.min_threads)
+        break;
+    }
+
+    if (owner)
+    {
+      --owned_;
+      owner->exited_ = true;
+    }
+  }
+
+  void work_up(execution::outstanding_work_t::tracked_t) noexcept
+  {
+    work_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Only the last decrement takes the mutex, so that threads checking work_
+  // under it cannot miss the notification.
+  void work_down(execution::outstanding_work_t::tracked_t) noexcept
+  {
+    if (work_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.notify_all();
+    }
+  }
+
+  void work_up(execution::outstanding_work_t::untracked_t) noexcept {}
+  void work_down(execution::outstanding_work_t::untracked_t) noexcept {}
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  const options options_;
+  std::list<worker> threads_;
+  func_base* head_{nullptr};
+  func_base** tail_{&head_};
+  std::size_t queued_{0};
+  std::atomic<std::size_t> owned_{0}; // Modified only while holding mutex_.
+  std::atomic<std::size_t> attached_{0};
+  std::atomic<std::size_t> idle_{0}; // Modified only while holding mutex_.
+  bool stopped_{false};
+  bool waited_{false};
+  std::atomic<std::size_t> work_{1}; // Outstanding work, including the pool's own until wait().
+};
+
+} // inline namespace executors_v1
+} // namespace experimental
+} // namespace std
+
+#endif // STD_EXPERIMENTAL_BITS_ELASTIC_THREAD_POOL_H
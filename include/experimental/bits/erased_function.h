@@ -0,0 +1,101 @@
+#ifndef STD_EXPERIMENTAL_BITS_ERASED_FUNCTION_H
+#define STD_EXPERIMENTAL_BITS_ERASED_FUNCTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace std {
+namespace experimental {
+inline namespace executors_v1 {
+namespace execution {
+namespace executor_impl {
+
+// Reference to a function object of unknown type, used by the polymorphic
+// executor to pass a submitted function to its target. A target that queues
+// functions may move the function into storage of its own, so that it is
+// allocated only once.
+class erased_function
+{
+public:
+  template<class Function,
+    class = typename std::enable_if<!std::is_same<Function, erased_function>::value>::type>
+  explicit erased_function(Function& f) noexcept
+    : function_(std::addressof(f)), operations_(&operations_for<Function>) {}
+
+  std::size_t size() const noexcept { return operations_->size_; }
+  std::size_t alignment() const noexcept { return operations_->alignment_; }
+  void* address() const noexcept { return function_; }
+
+  // Bytes needed to store the function after an object of the given size, in
+  // storage aligned only to std::max_align_t. An over-aligned function needs
+  // room to be aligned explicitly.
+  std::size_t size_after(std::size_t header_size) const noexcept
+  {
+    if (alignment() <= alignof(std::max_align_t))
+      return (header_size + alignment() - 1) / alignment() * alignment() + size();
+    return header_size + alignment() - 1 + size();
+  }
+
+  // Suitably aligned address at which to store the function after an object.
+  void* address_after(void* header, std::size_t header_size) const noexcept
+  {
+    std::uintptr_t p = reinterpret_cast<std::uintptr_t>(header) + header_size;
+    return reinterpret_cast<void*>((p + alignment() - 1) & ~std::uintptr_t(alignment() - 1));
+  }
+
+  // Move constructs the function in uninitialised storage, returning a
+  // reference to the new object. The caller is responsible for destroying it.
+  erased_function move_to(void* p) const
+  {
+    operations_->move_(function_, p);
+    return erased_function(p, operations_);
+  }
+
+  void operator()() const { operations_->call_(function_); }
+
+  void destroy() const noexcept { operations_->destroy_(function_); }
+
+private:
+  struct operations
+  {
+    std::size_t size_;
+    std::size_t alignment_;
+    void (*move_)(void*, void*);
+    void (*call_)(void*);
+    void (*destroy_)(void*) noexcept;
+  };
+
+  template<class Function>
+  static constexpr operations operations_for =
+  {
+    sizeof(Function),
+    alignof(Function),
+    [](void* from, void* to) { new (to) Function(std::move(*static_cast<Function*>(from))); },
+    [](void* f) { (*static_cast<Function*>(f))(); },
+    [](void* f) noexcept { static_cast<Function*>(f)->~Function(); }
+  };
+
+  erased_function(void* f, const operations* o) noexcept : function_(f), operations_(o) {}
+
+  void* function_;
+  const operations* operations_;
+};
+
+// Trait detecting targets that accept erased functions.
+template<class Executor, class = void>
+struct can_execute_erased : std::false_type {};
+
+template<class Executor>
+struct can_execute_erased<Executor, decltype(std::declval<const Executor&>().execute_erased(std::declval<const erased_function&>()))>
+  : std::true_type {};
+
+} // namespace executor_impl
+} // namespace execution
+} // inline namespace executors_v1
+} // namespace experimental
+} // namespace std
+
+#endif // STD_EXPERIMENTAL_BITS_ERASED_FUNCTION_H
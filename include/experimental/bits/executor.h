@@ -1,11 +1,16 @@
 #ifndef STD_EXPERIMENTAL_BITS_EXECUTOR_H
 #define STD_EXPERIMENTAL_BITS_EXECUTOR_H
 
+#include <array>
 #include <atomic>
 #include <cassert>
 #include <experimental/bits/bad_executor.h>
+#include <experimental/bits/erased_function.h>
 #include <experimental/future>
 #include <memory>
+#include <new>
+#include <optional>
+#include <tuple>
 #include <utility>
 
 namespace std {
@@ -62,6 +67,26 @@ struct find_convertible_property<Property> {};
 template<class Property, class... SupportableProperties>
 using find_convertible_property_t = typename find_convertible_property<Property, SupportableProperties...>::type;
 
+template<class Property, class... SupportableProperties>
+struct index_of_property;
+
+template<class Property, class Head, class... Tail>
+struct index_of_property<Property, Head, Tail...>
+  : std::conditional<std::is_same<Property, Head>::value, std::integral_constant<std::size_t, 0>,
+      std::integral_constant<std::size_t, 1 + index_of_property<Property, Tail...>::value>>::type {};
+
+template<class Property>
+struct index_of_property<Property> : std::integral_constant<std::size_t, 0> {};
+
+template<class Property, class... SupportableProperties>
+static constexpr std::size_t index_of_property_v = index_of_property<Property, SupportableProperties...>::value;
+
+// Maps the position of each of an executor's properties to the position of
+// the same property in its target's property table. The positions differ once
+// an executor has been converted to one with fewer or reordered properties.
+template<class... SupportableProperties>
+using property_map = std::array<unsigned char, sizeof...(SupportableProperties)>;
+
 template<class PropertyList, class... SupportableProperties>
 struct contains_exact_property_list;
 
@@ -149,9 +174,6 @@ struct multi_use_func : multi_use_func_base<R, Args...>
   }
 };
 
-using oneway_func_base = single_use_func_base<void>;
-template<class Function> using oneway_func = single_use_func<Function, void>;
-
 using shared_factory_base = multi_use_func_base<std::shared_ptr<void>>;
 template<class SharedFactory> using shared_factory = multi_use_func<SharedFactory, std::shared_ptr<void>>;
 
@@ -164,53 +186,133 @@ template<class Function> using twoway_func = single_use_func<Function, std::shar
 using twoway_then_func_base = single_use_func_base<void, std::shared_ptr<void>, std::exception_ptr>;
 template<class Function> using twoway_then_func = single_use_func<Function, void, std::shared_ptr<void>, std::exception_ptr>;
 
+// Inline storage for the target. It has room for the target's vtable and
+// property table pointers and an executor of up to eight pointers, which
+// covers the thread pools' executors. Larger targets are allocated and shared
+// between copies.
+struct storage
+{
+  alignas(void*) unsigned char data_[10 * sizeof(void*)];
+};
+
+// A heap copy of an erased function, for targets that accept only function
+// objects.
+class owned_function
+{
+public:
+  explicit owned_function(const erased_function& f)
+    : function_(copy(f)), owner_(true)
+  {
+  }
+
+  owned_function(owned_function&& other) noexcept
+    : function_(other.function_), owner_(std::exchange(other.owner_, false))
+  {
+  }
+
+  owned_function& operator=(const owned_function&) = delete;
+
+  ~owned_function()
+  {
+    if (owner_)
+    {
+      function_.destroy();
+      ::operator delete(function_.address(), std::align_val_t(function_.alignment()));
+    }
+  }
+
+  void operator()() { function_(); }
+
+private:
+  static erased_function copy(const erased_function& f)
+  {
+    void* p = ::operator new(f.size(), std::align_val_t(f.alignment()));
+    try
+    {
+      return f.move_to(p);
+    }
+    catch (...)
+    {
+      ::operator delete(p, std::align_val_t(f.alignment()));
+      throw;
+    }
+  }
+
+  erased_function function_;
+  bool owner_;
+};
+
+// Identifies a target's type without RTTI, by the address of its token.
+template<class T>
+struct type_id
+{
+  static constexpr char token = 0;
+};
+
+struct impl_base;
+
+// Operations on a target for one of its supportable properties. A target has
+// a table of these, with one entry per property in the order of the list it
+// was created with, so require, prefer and query are a single indirect call.
+// The require and prefer entries are null for properties that are not
+// requirable or preferable respectively.
+struct property_fns
+{
+  impl_base* (*require_)(const impl_base& e, const void* p, storage& s);
+  impl_base* (*prefer_)(const impl_base& e, const void* p, storage& s);
+  // Stores the result in the caller's std::optional<std::tuple<R>>, where R is
+  // the property's polymorphic_query_result_type, if the target supports it.
+  void (*query_)(const impl_base& e, const void* p, void* result);
+};
+
 struct impl_base
 {
+  explicit impl_base(const property_fns* properties) noexcept : properties_(properties) {}
   virtual ~impl_base() {}
-  virtual impl_base* clone() const noexcept = 0;
+  virtual impl_base* clone(storage& s) const noexcept = 0;
+  virtual impl_base* move(storage& s) noexcept = 0;
   virtual void destroy() noexcept = 0;
-  virtual void execute(std::unique_ptr<oneway_func_base> f) = 0;
+  virtual void execute(const erased_function& f) = 0;
   virtual void twoway_execute(std::unique_ptr<twoway_func_base> f, std::unique_ptr<twoway_then_func_base> then) = 0;
   virtual void bulk_execute(std::unique_ptr<bulk_func_base> f, std::size_t n, std::shared_ptr<shared_factory_base> sf) = 0;
+#if defined(__cpp_rtti) || defined(_CPPRTTI)
   virtual const type_info& target_type() const = 0;
+#endif
+  virtual const void* target_id() const noexcept = 0;
   virtual void* target() = 0;
   virtual const void* target() const = 0;
   virtual bool equals(const impl_base* e) const noexcept = 0;
-  virtual impl_base* require(const type_info&, const void* p) const = 0;
-  virtual impl_base* prefer(const type_info&, const void* p) const = 0;
-  virtual void* query(const type_info&, const void* p) const = 0;
+  const property_fns* properties_;
 };
 
+// Creates the target in the storage if it fits, or on the heap otherwise.
+template<class Executor, class... SupportableProperties>
+impl_base* create_impl(Executor ex, storage& s);
+
 template<class Executor, class... SupportableProperties>
 struct impl : impl_base
 {
   Executor executor_;
-  std::atomic<std::size_t> ref_count_{1};
 
-  explicit impl(Executor ex) : executor_(std::move(ex)) {}
-
-  virtual impl_base* clone() const noexcept
-  {
-    impl* e = const_cast<impl*>(this);
-    ++e->ref_count_;
-    return e;
-  }
+  explicit impl(Executor ex) : impl_base(property_table()), executor_(std::move(ex)) {}
 
-  virtual void destroy() noexcept
+  template<class T> auto execute_helper(const erased_function& f)
+    -> typename std::enable_if<can_execute_erased<T>::value
+      && contains_exact_property_v<oneway_t, SupportableProperties...>
+        && contains_exact_property_v<single_t, SupportableProperties...>>::type
   {
-    if (--ref_count_ == 0)
-      delete this;
+    executor_.execute_erased(f);
   }
 
-  template<class T> auto execute_helper(T&& f)
-    -> typename std::enable_if<std::is_same<T, T>::value
+  template<class T> auto execute_helper(const erased_function& f)
+    -> typename std::enable_if<!can_execute_erased<T>::value
       && contains_exact_property_v<oneway_t, SupportableProperties...>
         && contains_exact_property_v<single_t, SupportableProperties...>>::type
   {
-    executor_.execute([f = std::move(f)]() mutable { f.release()->call(); });
+    executor_.execute(owned_function(f));
   }
 
-  template<class T> auto execute_helper(T&&)
+  template<class T> auto execute_helper(const erased_function&)
     -> typename std::enable_if<!std::is_same<T, T>::value
       || !contains_exact_property_v<oneway_t, SupportableProperties...>
         || !contains_exact_property_v<single_t, SupportableProperties...>>::type
@@ -218,9 +320,9 @@ struct impl : impl_base
     assert(0);
   }
 
-  virtual void execute(std::unique_ptr<oneway_func_base> f)
+  virtual void execute(const erased_function& f)
   {
-    this->execute_helper<>(f);
+    this->execute_helper<Executor>(f);
   }
 
   template<class T, class U> auto twoway_execute_helper(T&& f, U&& then)
@@ -281,10 +383,17 @@ struct impl : impl_base
     this->bulk_execute_helper<>(f, n, sf);
   }
 
+#if defined(__cpp_rtti) || defined(_CPPRTTI)
   virtual const type_info& target_type() const
   {
     return typeid(executor_);
   }
+#endif
+
+  virtual const void* target_id() const noexcept
+  {
+    return &type_id<Executor>::token;
+  }
 
   virtual void* target()
   {
@@ -300,91 +409,162 @@ struct impl : impl_base
   {
     if (this == e)
       return true;
-    if (target_type() != e->target_type())
+    if (target_id() != e->target_id())
       return false;
     return executor_ == *static_cast<const Executor*>(e->target());
   }
 
-  impl_base* require_helper(property_list<>, const type_info&, const void*) const
+  template<class Property>
+  static impl_base* require_property(const impl_base& e, const void* p, storage& s)
+  {
+    const Executor& ex = static_cast<const impl&>(e).executor_;
+    return create_impl<decltype(execution::require(ex, *static_cast<const Property*>(p))), SupportableProperties...>(
+        execution::require(ex, *static_cast<const Property*>(p)), s);
+  }
+
+  template<class Property>
+  static impl_base* prefer_property(const impl_base& e, const void* p, storage& s)
+  {
+    const Executor& ex = static_cast<const impl&>(e).executor_;
+    return create_impl<decltype(execution::prefer(ex, *static_cast<const Property*>(p))), SupportableProperties...>(
+        execution::prefer(ex, *static_cast<const Property*>(p)), s);
+  }
+
+  template<class Property>
+  static void query_property(const impl_base& e, const void* p, void* result)
+  {
+    using result_type = std::optional<std::tuple<typename Property::polymorphic_query_result_type>>;
+    const Executor& ex = static_cast<const impl&>(e).executor_;
+    static_cast<result_type*>(result)->emplace(execution::query(ex, *static_cast<const Property*>(p)));
+  }
+
+  static void query_unsupported(const impl_base&, const void*, void*)
+  {
+  }
+
+  template<class Property>
+  static constexpr auto require_entry(typename std::enable_if<Property::is_requirable>::type* = 0)
+  {
+    return &require_property<Property>;
+  }
+
+  template<class Property>
+  static constexpr decltype(property_fns::require_) require_entry(typename std::enable_if<!Property::is_requirable>::type* = 0)
   {
-    assert(0);
     return nullptr;
   }
 
-  template<class Head, class... Tail>
-  impl_base* require_helper(property_list<Head, Tail...>, const type_info& t, const void* p, typename std::enable_if<Head::is_requirable>::type* = 0) const
+  template<class Property>
+  static constexpr auto prefer_entry(typename std::enable_if<Property::is_preferable>::type* = 0)
   {
-    if (t == typeid(Head))
-    {
-      using executor_type = decltype(execution::require(executor_, *static_cast<const Head*>(p)));
-      return new impl<executor_type, SupportableProperties...>(execution::require(executor_, *static_cast<const Head*>(p)));
-    }
-    return require_helper(property_list<Tail...>{}, t, p);
+    return &prefer_property<Property>;
   }
 
-  template<class Head, class... Tail>
-  impl_base* require_helper(property_list<Head, Tail...>, const type_info& t, const void* p, typename std::enable_if<!Head::is_requirable>::type* = 0) const
+  template<class Property>
+  static constexpr decltype(property_fns::prefer_) prefer_entry(typename std::enable_if<!Property::is_preferable>::type* = 0)
   {
-    return require_helper(property_list<Tail...>{}, t, p);
+    return nullptr;
   }
 
-  virtual impl_base* require(const type_info& t, const void* p) const
+  template<class Property>
+  static constexpr auto query_entry(typename std::enable_if<can_query_v<Executor, Property>>::type* = 0)
   {
-    return this->require_helper(property_list<SupportableProperties...>{}, t, p);
+    return &query_property<Property>;
   }
 
-  impl_base* prefer_helper(property_list<>, const type_info&, const void*) const
+  template<class Property>
+  static constexpr auto query_entry(typename std::enable_if<!can_query_v<Executor, Property>>::type* = 0)
   {
-    return clone();
+    return &query_unsupported;
   }
 
-  template<class Head, class... Tail>
-  impl_base* prefer_helper(property_list<Head, Tail...>, const type_info& t, const void* p, typename std::enable_if<Head::is_preferable>::type* = 0) const
+  // The trailing entry keeps the table non-empty for an empty property list.
+  static const property_fns* property_table() noexcept
   {
-    if (t == typeid(Head))
+    static constexpr property_fns table[] =
     {
-      using executor_type = decltype(execution::prefer(executor_, *static_cast<const Head*>(p)));
-      return new impl<executor_type, SupportableProperties...>(execution::prefer(executor_, *static_cast<const Head*>(p)));
-    }
-    return prefer_helper(property_list<Tail...>{}, t, p);
+      { require_entry<SupportableProperties>(), prefer_entry<SupportableProperties>(), query_entry<SupportableProperties>() }...,
+      {}
+    };
+    return table;
   }
+};
+
+// A target held in the executor's storage. Copies copy the target.
+template<class Executor, class... SupportableProperties>
+struct inline_impl : impl<Executor, SupportableProperties...>
+{
+  using impl<Executor, SupportableProperties...>::impl;
 
-  template<class Head, class... Tail>
-  impl_base* prefer_helper(property_list<Head, Tail...>, const type_info& t, const void* p, typename std::enable_if<!Head::is_preferable>::type* = 0) const
+  virtual impl_base* clone(storage& s) const noexcept
   {
-    return prefer_helper(property_list<Tail...>{}, t, p);
+    return new (&s) inline_impl(this->executor_);
   }
 
-  virtual impl_base* prefer(const type_info& t, const void* p) const
+  virtual impl_base* move(storage& s) noexcept
   {
-    return this->prefer_helper(property_list<SupportableProperties...>{}, t, p);
+    impl_base* p = new (&s) inline_impl(std::move(this->executor_));
+    this->~inline_impl();
+    return p;
   }
 
-  void* query_helper(property_list<>, const type_info&, const void*) const
+  virtual void destroy() noexcept
   {
-    return nullptr;
+    this->~inline_impl();
   }
+};
+
+// A target on the heap, shared between copies.
+template<class Executor, class... SupportableProperties>
+struct shared_impl : impl<Executor, SupportableProperties...>
+{
+  std::atomic<std::size_t> ref_count_{1};
 
-  template<class Head, class... Tail>
-  void* query_helper(property_list<Head, Tail...>, const type_info& t, const void* p, typename std::enable_if<can_query_v<Executor, Head>>::type* = 0) const
+  using impl<Executor, SupportableProperties...>::impl;
+
+  virtual impl_base* clone(storage&) const noexcept
   {
-    if (t == typeid(Head))
-      return new std::tuple<typename Head::polymorphic_query_result_type>(execution::query(executor_, *static_cast<const Head*>(p)));
-    return query_helper(property_list<Tail...>{}, t, p);
+    shared_impl* e = const_cast<shared_impl*>(this);
+    ++e->ref_count_;
+    return e;
   }
 
-  template<class Head, class... Tail>
-  void* query_helper(property_list<Head, Tail...>, const type_info& t, const void* p, typename std::enable_if<!can_query_v<Executor, Head>>::type* = 0) const
+  virtual impl_base* move(storage&) noexcept
   {
-    return query_helper(property_list<Tail...>{}, t, p);
+    return this;
   }
 
-  virtual void* query(const type_info& t, const void* p) const
+  virtual void destroy() noexcept
   {
-    return this->query_helper(property_list<SupportableProperties...>{}, t, p);
+    if (--ref_count_ == 0)
+      delete this;
   }
 };
 
+template<class Executor, class Impl>
+struct fits_storage
+  : std::integral_constant<bool, sizeof(Impl) <= sizeof(storage)
+      && alignof(Impl) <= alignof(storage) && std::is_nothrow_move_constructible<Executor>::value> {};
+
+template<class Executor, class... SupportableProperties>
+inline impl_base* create_impl(Executor ex, storage& s, std::true_type)
+{
+  return new (&s) inline_impl<Executor, SupportableProperties...>(std::move(ex));
+}
+
+template<class Executor, class... SupportableProperties>
+inline impl_base* create_impl(Executor ex, storage&, std::false_type)
+{
+  return new shared_impl<Executor, SupportableProperties...>(std::move(ex));
+}
+
+template<class Executor, class... SupportableProperties>
+inline impl_base* create_impl(Executor ex, storage& s)
+{
+  return create_impl<Executor, SupportableProperties...>(std::move(ex), s,
+      fits_storage<Executor, inline_impl<Executor, SupportableProperties...>>());
+}
+
 } // namespace executor_impl
 
 template<class... SupportableProperties>
@@ -404,12 +584,12 @@ public:
   }
 
   executor(const executor& e) noexcept
-    : impl_(e.impl_ ? e.impl_->clone() : nullptr)
+    : impl_(e.impl_ ? e.impl_->clone(storage_) : nullptr), map_(e.map_)
   {
   }
 
   executor(executor&& e) noexcept
-    : impl_(e.impl_)
+    : impl_(e.impl_ ? e.impl_->move(storage_) : nullptr), map_(e.map_)
   {
     e.impl_ = nullptr;
   }
@@ -423,7 +603,7 @@ public:
         executor_impl::conditional_property_t<bulk_t, SupportableProperties...>{},
         executor_impl::conditional_property_t<oneway_t, SupportableProperties...>{},
         executor_impl::conditional_property_t<twoway_t, SupportableProperties...>{});
-    impl_ = new executor_impl::impl<decltype(e2), SupportableProperties...>(std::move(e2));
+    impl_ = executor_impl::create_impl<decltype(e2), SupportableProperties...>(std::move(e2), storage_);
   }
 
   template<class... OtherSupportableProperties>
@@ -431,8 +611,10 @@ public:
       typename std::enable_if<executor_impl::contains_exact_property_list_v<
         executor_impl::property_list<SupportableProperties...>,
           OtherSupportableProperties...>>::type* = 0)
-    : impl_(e.impl_ ? e.impl_->clone() : nullptr)
+    : impl_(e.impl_ ? e.impl_->move(storage_) : nullptr),
+      map_{{e.map_[executor_impl::index_of_property_v<SupportableProperties, OtherSupportableProperties...>]...}}
   {
+    e.impl_ = nullptr;
   }
 
   template<class... OtherSupportableProperties>
@@ -443,8 +625,12 @@ public:
 
   executor& operator=(const executor& e) noexcept
   {
-    if (impl_) impl_->destroy();
-    impl_ = e.impl_ ? e.impl_->clone() : nullptr;
+    if (this != &e)
+    {
+      if (impl_) impl_->destroy();
+      impl_ = e.impl_ ? e.impl_->clone(storage_) : nullptr;
+      map_ = e.map_;
+    }
     return *this;
   }
 
@@ -453,7 +639,8 @@ public:
     if (this != &e)
     {
       if (impl_) impl_->destroy();
-      impl_ = e.impl_;
+      impl_ = e.impl_ ? e.impl_->move(storage_) : nullptr;
+      map_ = e.map_;
       e.impl_ = nullptr;
     }
     return *this;
@@ -480,7 +667,9 @@ public:
 
   void swap(executor& other) noexcept
   {
-    std::swap(impl_, other.impl_);
+    executor tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
   }
 
   template<class Executor> void assign(Executor e)
@@ -496,7 +685,11 @@ public:
   executor require(const Property& p) const
   {
     executor_impl::find_convertible_property_t<Property, SupportableProperties...> p1(p);
-    return impl_ ? impl_->require(typeid(p1), &p1) : throw bad_executor();
+    if (!impl_) throw bad_executor();
+    executor result;
+    result.impl_ = property_fns_for<decltype(p1)>().require_(*impl_, &p1, result.storage_);
+    result.map_ = map_;
+    return result;
   }
 
   template<class Property,
@@ -505,7 +698,11 @@ public:
   friend executor prefer(const executor& e, const Property& p)
   {
     executor_impl::find_convertible_property_t<Property, SupportableProperties...> p1(p);
-    return e.get_impl() ? e.get_impl()->prefer(typeid(p1), &p1) : throw bad_executor();
+    if (!e.get_impl()) throw bad_executor();
+    executor result;
+    result.impl_ = e.property_fns_for<decltype(p1)>().prefer_(*e.get_impl(), &p1, result.storage_);
+    result.map_ = e.map_;
+    return result;
   }
 
   template<class Property>
@@ -517,9 +714,9 @@ public:
   {
     executor_impl::find_convertible_property_t<Property, SupportableProperties...> p1(p);
     using result_type = typename decltype(p1)::polymorphic_query_result_type;
-    using tuple_type = std::tuple<result_type>;
     if (!impl_) throw bad_executor();
-    std::unique_ptr<tuple_type> result(static_cast<tuple_type*>(impl_->query(typeid(p1), &p1)));
+    std::optional<std::tuple<result_type>> result;
+    property_fns_for<decltype(p1)>().query_(*impl_, &p1, &result);
     return result ? std::get<0>(*result) : result_type();
   }
 
@@ -532,9 +729,9 @@ public:
   {
     executor_impl::find_convertible_property_t<Property, SupportableProperties...> p1(p);
     using result_type = typename decltype(p1)::polymorphic_query_result_type;
-    using tuple_type = std::tuple<result_type>;
     if (!impl_) throw bad_executor();
-    std::unique_ptr<tuple_type> result(static_cast<tuple_type*>(impl_->query(typeid(p1), &p1)));
+    std::optional<std::tuple<result_type>> result;
+    property_fns_for<decltype(p1)>().query_(*impl_, &p1, &result);
     return std::get<0>(*result);
   }
 
@@ -544,8 +741,7 @@ public:
         && executor_impl::contains_exact_property_v<single_t, SupportableProperties...>>::type>
   void execute(Function f) const
   {
-    std::unique_ptr<executor_impl::oneway_func_base> fp(new executor_impl::oneway_func<Function>(std::move(f)));
-    impl_ ? impl_->execute(std::move(fp)) : throw bad_executor();
+    impl_ ? impl_->execute(executor_impl::erased_function(f)) : throw bad_executor();
   }
 
   template<class Function,
@@ -644,19 +840,23 @@ public:
 
   // polymorphic executor target access:
 
+#if defined(__cpp_rtti) || defined(_CPPRTTI)
   const type_info& target_type() const noexcept
   {
     return impl_ ? impl_->target_type() : typeid(void);
   }
+#endif
 
   template<class Executor> Executor* target() noexcept
   {
-    return impl_ ? static_cast<Executor*>(impl_->target()) : nullptr;
+    return impl_ && impl_->target_id() == &executor_impl::type_id<Executor>::token
+      ? static_cast<Executor*>(impl_->target()) : nullptr;
   }
 
   template<class Executor> const Executor* target() const noexcept
   {
-    return impl_ ? static_cast<Executor*>(impl_->target()) : nullptr;
+    return impl_ && impl_->target_id() == &executor_impl::type_id<Executor>::token
+      ? static_cast<const Executor*>(get_impl()->target()) : nullptr;
   }
 
   // polymorphic executor comparisons:
@@ -697,9 +897,17 @@ public:
 
 private:
   template<class...> friend class executor;
-  executor(executor_impl::impl_base* i) noexcept : impl_(i) {}
+  executor_impl::storage storage_;
   executor_impl::impl_base* impl_;
+  executor_impl::property_map<SupportableProperties...> map_{{
+    executor_impl::index_of_property_v<SupportableProperties, SupportableProperties...>...}};
   const executor_impl::impl_base* get_impl() const { return impl_; }
+
+  template<class Property>
+  const executor_impl::property_fns& property_fns_for() const
+  {
+    return impl_->properties_[map_[executor_impl::index_of_property_v<Property, SupportableProperties...>]];
+  }
 };
 
 // executor specialized algorithms:
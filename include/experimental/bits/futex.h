@@ -0,0 +1,101 @@
+#ifndef STD_EXPERIMENTAL_BITS_FUTEX_H
+#define STD_EXPERIMENTAL_BITS_FUTEX_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__linux__)
+# include <climits>
+# include <ctime>
+# include <linux/futex.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#else
+# include <condition_variable>
+# include <mutex>
+#endif
+
+namespace std {
+namespace experimental {
+inline namespace executors_v1 {
+namespace futex_impl {
+
+// Blocking on the value of a 32-bit atomic word. Waits may return spuriously,
+// so callers re-check the word. Wakers must change the word before waking.
+
+#if defined(__linux__)
+
+inline void wait(const std::atomic<std::uint32_t>& word, std::uint32_t expected) noexcept
+{
+  ::syscall(SYS_futex, reinterpret_cast<const std::uint32_t*>(&word),
+      FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+inline void wait_until(const std::atomic<std::uint32_t>& word, std::uint32_t expected,
+    std::chrono::steady_clock::time_point abs_time) noexcept
+{
+  auto rel_time = abs_time - std::chrono::steady_clock::now();
+  if (rel_time <= rel_time.zero())
+    return;
+  auto secs = std::chrono::duration_cast<std::chrono::seconds>(rel_time);
+  auto nsecs = std::chrono::duration_cast<std::chrono::nanoseconds>(rel_time - secs);
+  timespec timeout{static_cast<std::time_t>(secs.count()), static_cast<long>(nsecs.count())};
+  ::syscall(SYS_futex, reinterpret_cast<const std::uint32_t*>(&word),
+      FUTEX_WAIT_PRIVATE, expected, &timeout, nullptr, 0);
+}
+
+inline void wake_all(std::atomic<std::uint32_t>& word) noexcept
+{
+  ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+      FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+// Elsewhere, waiters park on one of a fixed set of condition variables,
+// chosen by the word's address.
+struct bucket
+{
+  std::mutex mutex_;
+  std::condition_variable condition_;
+};
+
+inline bucket& bucket_for(const void* p) noexcept
+{
+  static bucket buckets[16];
+  return buckets[(reinterpret_cast<std::uintptr_t>(p) >> 4) % 16];
+}
+
+inline void wait(const std::atomic<std::uint32_t>& word, std::uint32_t expected) noexcept
+{
+  bucket& b = bucket_for(&word);
+  std::unique_lock<std::mutex> lock(b.mutex_);
+  if (word.load(std::memory_order_relaxed) == expected)
+    b.condition_.wait(lock);
+}
+
+inline void wait_until(const std::atomic<std::uint32_t>& word, std::uint32_t expected,
+    std::chrono::steady_clock::time_point abs_time) noexcept
+{
+  bucket& b = bucket_for(&word);
+  std::unique_lock<std::mutex> lock(b.mutex_);
+  if (word.load(std::memory_order_relaxed) == expected)
+    b.condition_.wait_until(lock, abs_time);
+}
+
+inline void wake_all(std::atomic<std::uint32_t>& word) noexcept
+{
+  bucket& b = bucket_for(&word);
+  std::unique_lock<std::mutex> lock(b.mutex_);
+  b.condition_.notify_all();
+}
+
+#endif
+
+} // namespace futex_impl
+} // inline namespace executors_v1
+} // namespace experimental
+} // namespace std
+
+#endif // STD_EXPERIMENTAL_BITS_FUTEX_H
@@ -2,55 +2,511 @@
 #define STD_EXPERIMENTAL_BITS_FUTURE_H
 
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <experimental/bits/futex.h>
 #include <future>
 #include <functional>
 #include <memory>
+#include <new>
+#include <optional>
+#include <utility>
 
 namespace std {
 namespace experimental {
 inline namespace executors_v1 {
 namespace future_impl {
 
-template<class R, class... Args>
-struct function_base
+// Function run when a shared state becomes ready. It is responsible for its
+// own storage, which must not be touched by the state once it has run.
+struct continuation_base
 {
-  virtual ~function_base() {}
-  virtual R call(Args...) = 0;
+  virtual void run(bool nested_inside_then) = 0;
+  virtual void discard() noexcept = 0;
+
+protected:
+  ~continuation_base() = default;
+
+private:
+  friend class shared_state_base;
+  continuation_base* next_ = nullptr;
 };
 
-template<class Function, class R, class...Args>
-struct function : function_base<R, Args...>
+template<class Function>
+struct continuation final : continuation_base
 {
   Function function_;
-  function(Function f) : function_(std::move(f)) {}
-  virtual R call(Args... args) { return function_(std::forward<Args>(args)...); }
+  explicit continuation(Function f) : function_(std::move(f)) {}
+
+  void run(bool nested_inside_then) override
+  {
+    std::unique_ptr<continuation> self(this);
+    function_(nested_inside_then);
+  }
+
+  void discard() noexcept override
+  {
+    delete this;
+  }
 };
 
-struct continuation
+// Shared state of a promise and its futures, holding the result and the
+// continuations in a single allocation. Readiness is published through an
+// atomic word, on which waiters block. Continuations are pushed onto an
+// intrusive list, which is closed when the state becomes ready.
+class shared_state_base
 {
-  std::unique_ptr<function_base<void, bool>> function_;
-  std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
+public:
+  shared_state_base() = default;
+  shared_state_base(const shared_state_base&) = delete;
+  shared_state_base& operator=(const shared_state_base&) = delete;
+
+  void add_ref() noexcept
+  {
+    refs_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void release() noexcept
+  {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      destroy();
+  }
+
+  // Marks the future as retrieved, which may happen only once.
+  void retrieve()
+  {
+    if (state_.fetch_or(retrieved, std::memory_order_relaxed) & retrieved)
+      throw std::future_error(std::future_errc::future_already_retrieved);
+  }
+
+  bool is_ready() const noexcept
+  {
+    return (state_.load(std::memory_order_acquire) & ready) != 0;
+  }
+
+  void wait() const noexcept
+  {
+    for (std::uint32_t s = state_.load(std::memory_order_acquire); !(s & ready); s = state_.load(std::memory_order_acquire))
+      if (announce_waiter(s))
+        futex_impl::wait(state_, s);
+  }
+
+  bool wait_until(std::chrono::steady_clock::time_point abs_time) const noexcept
+  {
+    for (std::uint32_t s = state_.load(std::memory_order_acquire); !(s & ready); s = state_.load(std::memory_order_acquire))
+    {
+      if (std::chrono::steady_clock::now() >= abs_time)
+        return false;
+      if (announce_waiter(s))
+        futex_impl::wait_until(state_, s, abs_time);
+    }
+    return true;
+  }
+
+  // Waits are measured on the steady clock, re-checking other clocks on wake.
+  template<class Clock, class Duration>
+  bool wait_until(const std::chrono::time_point<Clock, Duration>& abs_time) const
+  {
+    for (;;)
+    {
+      auto now = Clock::now();
+      if (is_ready())
+        return true;
+      if (now >= abs_time)
+        return false;
+      if (wait_until(std::chrono::steady_clock::now()
+            + std::chrono::ceil<std::chrono::steady_clock::duration>(abs_time - now)))
+        return true;
+    }
+  }
+
+  // Runs the continuation when the state becomes ready, or immediately with an
+  // argument of true if it already is.
+  template<class Function>
+  void attach(Function f)
+  {
+    continuation_base* c = new continuation<Function>(std::move(f));
+    if (!try_attach(c))
+      c->run(true);
+  }
+
+  // Adds a continuation that is run when the state becomes ready. Returns
+  // false, leaving the continuation unused, if the state is already ready.
+  bool try_attach(continuation_base* c) noexcept
+  {
+    continuation_base* head = continuations_.load(std::memory_order_acquire);
+    do
+    {
+      if (head == closed())
+        return false;
+      c->next_ = head;
+    } while (!continuations_.compare_exchange_weak(head, c,
+          std::memory_order_release, std::memory_order_acquire));
+    return true;
+  }
+
+  // Removes a continuation added by try_attach(). The list is taken over while
+  // the continuation is unlinked, and the others are then added back, or run
+  // if the state became ready in the meantime. Returns false if the list is
+  // already closed, in which case the continuation is being or has been run.
+  bool try_detach(continuation_base* c) noexcept
+  {
+    continuation_base* head = continuations_.load(std::memory_order_acquire);
+    do
+    {
+      if (head == closed())
+        return false;
+    } while (!continuations_.compare_exchange_weak(head, nullptr,
+          std::memory_order_acquire, std::memory_order_acquire));
+
+    // Reverse the others, so that they are added back in their original order.
+    continuation_base* first = nullptr;
+    while (head)
+    {
+      continuation_base* next = head->next_;
+      if (head != c)
+      {
+        head->next_ = first;
+        first = head;
+      }
+      head = next;
+    }
+    while (first)
+    {
+      continuation_base* next = first->next_;
+      if (!try_attach(first))
+        first->run(false);
+      first = next;
+    }
+    return true;
+  }
+
+protected:
+  virtual ~shared_state_base()
+  {
+    continuation_base* c = continuations_.load(std::memory_order_relaxed);
+    while (c && c != closed())
+      std::exchange(c, c->next_)->discard();
+  }
+
+  virtual void destroy() noexcept
+  {
+    delete this;
+  }
+
+  // Claims the right to store the result. The claim is returned if storing fails.
+  void satisfy()
+  {
+    if (state_.fetch_or(satisfied, std::memory_order_relaxed) & satisfied)
+      throw std::future_error(std::future_errc::promise_already_satisfied);
+  }
+
+  bool is_satisfied() const noexcept
+  {
+    return (state_.load(std::memory_order_relaxed) & satisfied) != 0;
+  }
+
+  void unsatisfy() noexcept
+  {
+    state_.fetch_and(~satisfied, std::memory_order_relaxed);
+  }
+
+  void make_ready() noexcept
+  {
+    if (state_.fetch_or(ready, std::memory_order_acq_rel) & waiting)
+      futex_impl::wake_all(state_);
+    run_continuations();
+  }
+
+  bool has_value() const noexcept
+  {
+    return (state_.load(std::memory_order_acquire) & ready) && !exception_;
+  }
+
+  std::exception_ptr exception_;
+
+private:
+  enum : std::uint32_t
+  {
+    ready = 1,
+    waiting = 2,
+    satisfied = 4,
+    retrieved = 8
+  };
+
+  static continuation_base* closed() noexcept
+  {
+    static char sentinel;
+    return reinterpret_cast<continuation_base*>(&sentinel);
+  }
+
+  // Sets the waiting bit, so that make_ready() will wake the futex. Returns
+  // false if the state changed and must be re-read.
+  bool announce_waiter(std::uint32_t& s) const noexcept
+  {
+    return (s & waiting) || state_.compare_exchange_weak(s, s | waiting, std::memory_order_acquire)
+      ? (s |= waiting, true) : false;
+  }
+
+  // Closes the list and runs the continuations in the order they were added.
+  // The last of them may release the last reference to this state, so the
+  // state is not touched once they start.
+  void run_continuations()
+  {
+    continuation_base* c = continuations_.exchange(closed(), std::memory_order_acq_rel);
+    continuation_base* first = nullptr;
+    while (c)
+    {
+      continuation_base* next = c->next_;
+      c->next_ = first;
+      first = c;
+      c = next;
+    }
+    while (first)
+      std::exchange(first, first->next_)->run(false);
+  }
+
+  mutable std::atomic<std::uint32_t> state_{0};
+  std::atomic<std::size_t> refs_{1};
+  std::atomic<continuation_base*> continuations_{nullptr};
 };
 
-using continuation_ptr = std::shared_ptr<continuation>;
+// Storage for each kind of result.
+template<class R>
+struct result_storage
+{
+  result_storage() noexcept {}
+  ~result_storage() {}
+  void construct(const R& r) { new (&value_) R(r); }
+  void construct(R&& r) { new (&value_) R(std::move(r)); }
+  void destroy_value() noexcept { value_.~R(); }
+  R take() { return std::move(value_); }
+  const R& ref() const noexcept { return value_; }
+  union { R value_; };
+};
 
-template<class Function>
-void attach(continuation_ptr& p, Function f)
+template<class R>
+struct result_storage<R&>
 {
-  p->function_.reset(new function<Function, void, bool>(std::move(f)));
-  if (p->flag_.test_and_set())
-    p->function_->call(true);
-}
+  void construct(R& r) noexcept { value_ = std::addressof(r); }
+  void destroy_value() noexcept {}
+  R& take() noexcept { return *value_; }
+  R& ref() const noexcept { return *value_; }
+  R* value_;
+};
 
-inline void make_ready(continuation_ptr& p)
+template<>
+struct result_storage<void>
 {
-  future_impl::continuation_ptr p1{std::move(p)};
-  if (p1->flag_.test_and_set())
-    p1->function_->call(false);
-}
+  void construct() noexcept {}
+  void destroy_value() noexcept {}
+  void take() noexcept {}
+  void ref() const noexcept {}
+};
+
+template<class R>
+class shared_state : public shared_state_base, private result_storage<R>
+{
+public:
+  template<class... Args>
+  auto set_value(Args&&... args)
+    -> decltype(std::declval<result_storage<R>&>().construct(std::forward<Args>(args)...))
+  {
+    this->satisfy();
+    try
+    {
+      this->construct(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+      this->unsatisfy();
+      throw;
+    }
+    this->make_ready();
+  }
+
+  void set_exception(std::exception_ptr e)
+  {
+    this->satisfy();
+    this->exception_ = std::move(e);
+    this->make_ready();
+  }
+
+  // Abandons the state with broken_promise if no result was stored.
+  void abandon() noexcept
+  {
+    if (this->is_satisfied())
+      return;
+    try
+    {
+      set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+    }
+    catch (const std::future_error&)
+    {
+    }
+  }
+
+  // Requires the state to be ready.
+  R get()
+  {
+    if (this->exception_)
+      std::rethrow_exception(this->exception_);
+    return this->take();
+  }
+
+  // Requires the state to be ready. The result is left in the state.
+  auto get_shared() const -> decltype(std::declval<const result_storage<R>&>().ref())
+  {
+    if (this->exception_)
+      std::rethrow_exception(this->exception_);
+    return this->ref();
+  }
+
+protected:
+  ~shared_state()
+  {
+    if (this->has_value())
+      this->destroy_value();
+  }
+};
+
+// Shared state of a packaged_task, which also holds the task's function until
+// the packaged_task is destroyed.
+template<class R, class... Args>
+class task_state_base : public shared_state<R>
+{
+public:
+  virtual void run(Args... args) = 0;
+  virtual void destroy_function() noexcept = 0;
+};
+
+template<class Function, class R, class... Args>
+class task_state : public task_state_base<R, Args...>
+{
+public:
+  explicit task_state(Function f) : function_(std::move(f)) {}
+
+  ~task_state()
+  {
+    destroy_function();
+  }
+
+  void run(Args... args) override
+  {
+    if (!alive_)
+      throw std::future_error(std::future_errc::no_state);
+    try
+    {
+      this->call(std::is_void<R>{}, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+      this->set_exception(std::current_exception());
+    }
+  }
+
+  void destroy_function() noexcept override
+  {
+    if (alive_)
+    {
+      function_.~Function();
+      alive_ = false;
+    }
+  }
+
+private:
+  void call(std::true_type, Args... args)
+  {
+    function_(std::forward<Args>(args)...);
+    this->set_value();
+  }
+
+  void call(std::false_type, Args... args)
+  {
+    this->set_value(function_(std::forward<Args>(args)...));
+  }
 
-template<class R> inline future<R> unwrap(future<R> f) { return f; }
-template<class R> inline future<R> unwrap(future<future<R>> f) { return {std::move(f)}; }
+  union { Function function_; };
+  bool alive_ = true;
+};
+
+// A shared state whose memory is obtained from an allocator.
+template<class State, class Allocator>
+class allocated_state : public State
+{
+  using allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<allocated_state>;
+  using traits = std::allocator_traits<allocator_type>;
+
+public:
+  template<class... Args>
+  explicit allocated_state(const allocator_type& a, Args&&... args)
+    : State(std::forward<Args>(args)...), allocator_(a) {}
+
+  template<class... Args>
+  static allocated_state* create(const Allocator& a, Args&&... args)
+  {
+    allocator_type alloc(a);
+    allocated_state* p = traits::allocate(alloc, 1);
+    try
+    {
+      traits::construct(alloc, p, alloc, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+      traits::deallocate(alloc, p, 1);
+      throw;
+    }
+    return p;
+  }
+
+private:
+  void destroy() noexcept override
+  {
+    allocator_type alloc(allocator_);
+    traits::destroy(alloc, this);
+    traits::deallocate(alloc, this, 1);
+  }
+
+  allocator_type allocator_;
+};
+
+// Owns one reference to a shared state.
+template<class State>
+class state_ptr
+{
+public:
+  state_ptr() noexcept = default;
+  explicit state_ptr(State* p) noexcept : p_(p) {}
+  state_ptr(const state_ptr& other) noexcept : p_(other.p_) { if (p_) p_->add_ref(); }
+  state_ptr(state_ptr&& other) noexcept : p_(std::exchange(other.p_, nullptr)) {}
+  template<class S> state_ptr(const state_ptr<S>& other) noexcept : p_(other.p_) { if (p_) p_->add_ref(); }
+  template<class S> state_ptr(state_ptr<S>&& other) noexcept : p_(std::exchange(other.p_, nullptr)) {}
+  ~state_ptr() { if (p_) p_->release(); }
+
+  state_ptr& operator=(state_ptr other) noexcept
+  {
+    std::swap(p_, other.p_);
+    return *this;
+  }
+
+  void swap(state_ptr& other) noexcept { std::swap(p_, other.p_); }
+
+  State* operator->() const noexcept { return p_; }
+  explicit operator bool() const noexcept { return p_ != nullptr; }
+
+private:
+  template<class> friend class state_ptr;
+  State* p_ = nullptr;
+};
+
+template<class Sequence, class Executor, bool Any> class when_state;
+template<class R, class Executor> class future_awaiter;
+template<class Future, class Executor, class Function> class then_state;
+
+// Result of a then() continuation, with a returned future unwrapped.
+template<class T> struct unwrapped { using type = T; };
+template<class T> struct unwrapped<future<T>> { using type = T; };
 
 struct default_executor
 {
@@ -62,6 +518,12 @@ public:
   constexpr bool query(execution::single_t) { return true; }
 };
 
+// Attaches a continuation owned by the caller, without consuming the future.
+// Returns false if the future is already ready, in which case the continuation
+// is not attached.
+template<class R>
+bool try_attach(const future<R>& f, continuation_base* c);
+
 } // namespace future_impl
 
 template<class R>
@@ -69,38 +531,55 @@ class promise
 {
   template<class> friend class future;
 
-  std::promise<R> impl_;
-  future_impl::continuation_ptr continuation_{std::make_shared<future_impl::continuation>()};
+  future_impl::state_ptr<future_impl::shared_state<R>> state_;
 
 public:
-  promise() = default;
+  promise() : state_(new future_impl::shared_state<R>) {}
   template<class Alloc>
     promise(std::allocator_arg_t, const Alloc& alloc)
-      : impl_(std::allocator_arg, alloc) {}
+      : state_(future_impl::allocated_state<future_impl::shared_state<R>, Alloc>::create(alloc)) {}
   promise(promise&& other) noexcept = default;
   promise(const promise& other) = delete;
   ~promise()
   {
-    if (continuation_)
-      set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+    if (state_)
+      state_->abandon();
+  }
+
+  promise& operator=(promise&& other) noexcept
+  {
+    promise(std::move(other)).swap(*this);
+    return *this;
   }
 
-  promise& operator=(promise&& other) noexcept = default;
   promise& operator=(const promise& other) = delete;
   void swap(promise& other) noexcept
   {
-    std::swap(impl_, other.impl_);
-    std::swap(continuation_, other.continuation_);
+    state_.swap(other.state_);
   }
 
-  future<R> get_future() { return {*this}; }
+  future<R> get_future()
+  {
+    if (!state_)
+      throw std::future_error(std::future_errc::no_state);
+    state_->retrieve();
+    return future<R>(state_);
+  }
 
   template <class... Args> auto set_value(Args&&... args)
-    -> decltype(impl_.set_value(std::forward<Args>(args)...))
-      { impl_.set_value(std::forward<Args>(args)...); make_ready(continuation_); }
-  template <class... Args> auto set_exception(Args&&... args)
-    -> decltype(impl_.set_exception(std::forward<Args>(args)...))
-      { impl_.set_exception(std::forward<Args>(args)...); make_ready(continuation_); }
+    -> decltype(state_->set_value(std::forward<Args>(args)...))
+  {
+    if (!state_)
+      throw std::future_error(std::future_errc::no_state);
+    state_->set_value(std::forward<Args>(args)...);
+  }
+
+  void set_exception(std::exception_ptr e)
+  {
+    if (!state_)
+      throw std::future_error(std::future_errc::no_state);
+    state_->set_exception(std::move(e));
+  }
 };
 
 template<class R> inline void swap(promise<R>& a, promise<R>& b) noexcept { a.swap(b); }
@@ -109,11 +588,16 @@ template<class R>
 class future
 {
   template<class> friend class future;
+  template<class> friend class shared_future;
   template<class> friend class promise;
+  template<class> friend class packaged_task;
+  template<class, class, bool> friend class future_impl::when_state;
+  template<class, class> friend class future_impl::future_awaiter;
+  template<class, class, class> friend class future_impl::then_state;
+  template<class T> friend bool future_impl::try_attach(const future<T>&, future_impl::continuation_base*);
 
-  std::future<R> impl_;
-  future_impl::continuation_ptr continuation_;
-  future(promise<R>& prom) : impl_(prom.impl_.get_future()), continuation_(prom.continuation_) {}
+  future_impl::state_ptr<future_impl::shared_state<R>> state_;
+  explicit future(future_impl::state_ptr<future_impl::shared_state<R>> state) noexcept : state_(std::move(state)) {}
 
 public:
   future() noexcept = default;
@@ -124,21 +608,32 @@ public:
   future(future<future<R>>&& fut);
   ~future() = default;
 
-  std::shared_future<R> share() { return impl_.share(); }
+  shared_future<R> share() noexcept { return shared_future<R>(std::move(*this)); }
 
-  auto get() -> decltype(impl_.get()) { return impl_.get(); }
+  R get()
+  {
+    if (!state_)
+      throw std::future_error(std::future_errc::no_state);
+    future_impl::state_ptr<future_impl::shared_state<R>> state(std::move(state_));
+    state->wait();
+    return state->get();
+  }
 
-  bool valid() const { return impl_.valid(); }
+  bool valid() const noexcept { return !!state_; }
 
-  bool is_ready() const { return impl_.wait_for(chrono::seconds(0)) == future_status::ready; }
+  bool is_ready() const noexcept { return state_->is_ready(); }
 
-  void wait() { return impl_.wait(); }
+  void wait() const { state_->wait(); }
   template<class Rep, class Period>
     future_status wait_for(const chrono::duration<Rep, Period>& rel_time) const
-      { return impl_.wait_for(rel_time); }
+  {
+    return this->wait_until(chrono::steady_clock::now() + chrono::ceil<chrono::steady_clock::duration>(rel_time));
+  }
   template<class Clock, class Duration>
     future_status wait_until(const chrono::time_point<Clock, Duration>& abs_time) const
-      { return impl_.wait_until(abs_time); }
+  {
+    return state_->wait_until(abs_time) ? future_status::ready : future_status::timeout;
+  }
 
   template<class Executor, class Function>
     auto then(Executor ex, Function f);
@@ -147,142 +642,289 @@ public:
     { return this->then(future_impl::default_executor(), std::move(f)); }
 };
 
+template<class R>
+class shared_future
+{
+  template<class, class, class> friend class future_impl::then_state;
+
+  future_impl::state_ptr<future_impl::shared_state<R>> state_;
+
+public:
+  shared_future() noexcept = default;
+  shared_future(const shared_future& other) noexcept = default;
+  shared_future(shared_future&& other) noexcept = default;
+  shared_future(future<R>&& other) noexcept : state_(std::move(other.state_)) {}
+  shared_future& operator=(const shared_future& other) noexcept = default;
+  shared_future& operator=(shared_future&& other) noexcept = default;
+  ~shared_future() = default;
+
+  // Returns a reference to the result held in the shared state.
+  auto get() const -> decltype(state_->get_shared())
+  {
+    if (!state_)
+      throw std::future_error(std::future_errc::no_state);
+    state_->wait();
+    return state_->get_shared();
+  }
+
+  bool valid() const noexcept { return !!state_; }
+
+  bool is_ready() const noexcept { return state_->is_ready(); }
+
+  void wait() const { state_->wait(); }
+  template<class Rep, class Period>
+    future_status wait_for(const chrono::duration<Rep, Period>& rel_time) const
+  {
+    return this->wait_until(chrono::steady_clock::now() + chrono::ceil<chrono::steady_clock::duration>(rel_time));
+  }
+  template<class Clock, class Duration>
+    future_status wait_until(const chrono::time_point<Clock, Duration>& abs_time) const
+  {
+    return state_->wait_until(abs_time) ? future_status::ready : future_status::timeout;
+  }
+
+  // Any number of continuations may be attached. Each receives a copy of this
+  // shared_future.
+  template<class Executor, class Function>
+    auto then(Executor ex, Function f) const;
+
+  template<class Function> auto then(Function f) const
+    { return this->then(future_impl::default_executor(), std::move(f)); }
+};
+
 namespace future_impl {
 
-template<class R, class F>
-inline void set_value(promise<R>& p, F f)
+template<class R>
+inline bool try_attach(const future<R>& f, continuation_base* c)
 {
-  p.set_value(f());
+  return f.state_->try_attach(c);
 }
 
-template<class F>
-inline void set_value(promise<void>& p, F f)
+// Shared state of the future returned by then(). The state is also the
+// continuation attached to the predecessor and, when the function returns a
+// future, to that future, so that each then() makes a single allocation.
+template<class Future, class Executor, class Function>
+class then_state
+  : public shared_state<typename unwrapped<typename std::result_of<Function(Future)>::type>::type>,
+    private continuation_base
 {
-  f();
-  p.set_value();
-}
+  using result_type = typename std::result_of<Function(Future)>::type;
+  using value_type = typename unwrapped<result_type>::type;
+
+public:
+  then_state(Future pred, Executor ex, Function f)
+    : predecessor_(std::move(pred)), executor_(std::move(ex)), function_(std::in_place, std::move(f)) {}
+
+  // Attaches to the predecessor. The continuation owns a second reference.
+  void start()
+  {
+    this->add_ref();
+    if (!predecessor_.state_->try_attach(this))
+      run(true);
+  }
+
+private:
+  // The function submitted to the executor. If the executor destroys it
+  // without running it, the promise is broken.
+  class invoker
+  {
+  public:
+    explicit invoker(then_state* state) noexcept : state_(state) {}
+    invoker(invoker&&) noexcept = default;
+    invoker& operator=(invoker&&) = delete;
+
+    ~invoker()
+    {
+      if (state_)
+        state_->abandon();
+    }
+
+    void operator()()
+    {
+      state_ptr<then_state> state(std::move(state_));
+      state->invoke();
+    }
+
+  private:
+    state_ptr<then_state> state_;
+  };
+
+  void run(bool nested_inside_then) override
+  {
+    if (inner_.valid())
+    {
+      state_ptr<then_state> self(this);
+      return forward_inner();
+    }
+
+    invoker func(this);
+    if (nested_inside_then)
+      executor_.execute(std::move(func));
+    else
+      execution::prefer(executor_, execution::blocking.possibly).execute(std::move(func));
+  }
+
+  void discard() noexcept override
+  {
+    this->release();
+  }
+
+  void invoke()
+  {
+    try
+    {
+      call(std::integral_constant<int,
+            std::is_void<result_type>::value ? 0 : std::is_same<result_type, value_type>::value ? 1 : 2>());
+    }
+    catch (...)
+    {
+      this->set_exception(std::current_exception());
+    }
+  }
+
+  // The function, and anything it captured, is destroyed as soon as it returns.
+  result_type call_function()
+  {
+    Function f(std::move(*function_));
+    function_.reset();
+    return f(std::move(predecessor_));
+  }
+
+  void call(std::integral_constant<int, 0>)
+  {
+    call_function();
+    this->set_value();
+  }
+
+  void call(std::integral_constant<int, 1>)
+  {
+    this->set_value(call_function());
+  }
+
+  // Unwraps a returned future by attaching to it in turn.
+  void call(std::integral_constant<int, 2>)
+  {
+    inner_ = call_function();
+    if (!inner_.valid())
+      throw std::future_error(std::future_errc::no_state);
+    this->add_ref();
+    if (!inner_.state_->try_attach(this))
+      run(true);
+  }
+
+  void forward_inner()
+  {
+    try
+    {
+      forward_inner(std::is_void<value_type>());
+    }
+    catch (...)
+    {
+      this->set_exception(std::current_exception());
+    }
+  }
+
+  void forward_inner(std::true_type)
+  {
+    inner_.get();
+    this->set_value();
+  }
+
+  void forward_inner(std::false_type)
+  {
+    this->set_value(inner_.get());
+  }
+
+  Future predecessor_;
+  future<value_type> inner_;
+  Executor executor_;
+  std::optional<Function> function_;
+};
 
 } // namespace future_impl
 
 template<class R>
 future<R>::future(future<future<R>>&& fut)
+  : future(fut.then([](future<future<R>> f) { return f.get(); }))
 {
-  promise<R> prom;
-  *this = prom.get_future();
-  future_impl::continuation_ptr cont(fut.continuation_);
-  attach(cont, [prom = std::move(prom), pred = std::move(fut)](bool) mutable
-      {
-        try
-        {
-          future<R> next = pred.get();
-          future_impl::continuation_ptr cont(next.continuation_);
-          attach(cont, [prom = std::move(prom), pred = std::move(next)](bool) mutable
-              {
-                try
-                {
-                  future_impl::set_value(prom, [&]{ return pred.get(); });
-                }
-                catch (...)
-                {
-                  prom.set_exception(std::current_exception());
-                }
-              });
-        }
-        catch (...)
-        {
-          prom.set_exception(std::current_exception());
-        }
-      });
 }
 
 template<class R> template<class Executor, class Function>
 auto future<R>::then(Executor ex, Function f)
 {
-  promise<typename std::result_of<Function(future)>::type> prom;
-  future<typename std::result_of<Function(future)>::type> fut(prom.get_future());
+  using executor_type = decltype(execution::require(std::move(ex), execution::oneway));
+  using state_type = future_impl::then_state<future, executor_type, Function>;
 
-  future_impl::continuation_ptr continuation(continuation_);
-  future_impl::attach(continuation,
-      [ex = execution::require(std::move(ex), execution::oneway), prom = std::move(prom),
-        pred = std::move(*this), f = std::move(f)](bool nested_inside_then) mutable
-      {
-        auto func = [prom = std::move(prom), pred = std::move(pred), f = std::move(f)]() mutable
-        {
-          try
-          {
-            future_impl::set_value(prom, [&]{ return f(std::move(pred)); });
-          }
-          catch (...)
-          {
-            prom.set_exception(std::current_exception());
-          }
-        };
-
-        if (nested_inside_then)
-        {
-          ex.execute(std::move(func));                                                    // #1: Least safe, most flexible
-          // or execution::prefer(ex, execution::non_blocking).execute(std::move(func));  // #2: Safe when supported, flexible with effort
-          // or execution::require(ex, execution::non_blocking).execute(std::move(func)); // #3: Safest, least flexible
-        }
-        else
-          execution::prefer(ex, execution::blocking.possibly).execute(std::move(func));
-      });
-
-  return future_impl::unwrap(std::move(fut));
+  future_impl::state_ptr<state_type> state(new state_type(std::move(*this),
+        execution::require(std::move(ex), execution::oneway), std::move(f)));
+  state->start();
+  return future<typename future_impl::unwrapped<typename std::result_of<Function(future)>::type>::type>(std::move(state));
+}
+
+template<class R> template<class Executor, class Function>
+auto shared_future<R>::then(Executor ex, Function f) const
+{
+  using executor_type = decltype(execution::require(std::move(ex), execution::oneway));
+  using state_type = future_impl::then_state<shared_future, executor_type, Function>;
+
+  future_impl::state_ptr<state_type> state(new state_type(*this,
+        execution::require(std::move(ex), execution::oneway), std::move(f)));
+  state->start();
+  return future<typename future_impl::unwrapped<typename std::result_of<Function(shared_future)>::type>::type>(std::move(state));
 }
 
 template<class R, class... Args>
 class packaged_task<R(Args...)>
 {
-  std::unique_ptr<promise<R>> promise_;
-  std::unique_ptr<future_impl::function_base<R, Args...>> task_;
+  future_impl::state_ptr<future_impl::task_state_base<R, Args...>> state_;
 
-  void call_helper(std::true_type, Args... args)
-  {
-    task_->call(std::forward<Args>(args)...);
-    promise_->set_value();
-  }
-
-  void call_helper(std::false_type, Args... args)
-  {
-    promise_->set_value(task_->call(std::forward<Args>(args)...));
-  }
+  template<class F>
+    using state_type = future_impl::task_state<typename std::decay<F>::type, R, Args...>;
 
 public:
   packaged_task() noexcept = default;
   template<class F> explicit packaged_task(F&& f)
-    : promise_(new promise<R>),
-      task_(new future_impl::function<typename std::decay<F>::type, R, Args...>(std::forward<F>(f))) {}
+    : state_(new state_type<F>(std::forward<F>(f))) {}
   template<class Allocator, class F>
     explicit packaged_task(std::allocator_arg_t, const Allocator& a, F&& f)
-      : promise_(new promise<R>(std::allocator_arg, a)),
-        task_(new future_impl::function<typename std::decay<F>::type, R, Args...>(std::forward<F>(f))) {}
+      : state_(future_impl::allocated_state<state_type<F>, Allocator>::create(a, std::forward<F>(f))) {}
   packaged_task(packaged_task&& other) = default;
   packaged_task(const packaged_task&) = delete;
-  packaged_task& operator=(packaged_task&& other) = default;
+  packaged_task& operator=(packaged_task&& other) noexcept
+  {
+    packaged_task(std::move(other)).swap(*this);
+    return *this;
+  }
   packaged_task& operator=(const packaged_task& other) = delete;
-  ~packaged_task() = default;
+  ~packaged_task()
+  {
+    if (state_)
+    {
+      state_->destroy_function();
+      state_->abandon();
+    }
+  }
 
-  bool valid() const noexcept { return !!task_; }
+  bool valid() const noexcept { return !!state_; }
 
   void swap(packaged_task& other) noexcept
   {
-    std::swap(promise_, other.promise_);
-    std::swap(task_, other.task_);
+    state_.swap(other.state_);
   }
 
-  future<R> get_future() { return promise_->get_future(); }
+  future<R> get_future()
+  {
+    if (!state_)
+      throw std::future_error(std::future_errc::no_state);
+    state_->retrieve();
+    return future<R>(state_);
+  }
 
   void operator()(Args... args)
-  { 
-    try
-    {
-      this->call_helper(typename std::is_same<R, void>::type{}, std::forward<Args>(args)...);
-    }
-    catch (...)
-    {
-      promise_->set_exception(std::current_exception());
-    }
+  {
+    if (!state_)
+      throw std::future_error(std::future_errc::no_state);
+    state_->run(std::forward<Args>(args)...);
   }
 };
 
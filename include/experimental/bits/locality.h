@@ -0,0 +1,57 @@
+#ifndef STD_EXPERIMENTAL_BITS_LOCALITY_H
+#define STD_EXPERIMENTAL_BITS_LOCALITY_H
+
+#include <cstddef>
+
+namespace std {
+namespace experimental {
+inline namespace executors_v1 {
+namespace execution {
+
+struct locality_t
+{
+  static constexpr bool is_requirable = true;
+  static constexpr bool is_preferable = true;
+
+  using polymorphic_query_result_type = locality_t;
+
+  template<class Executor, class Type = decltype(Executor::query(*static_cast<locality_t*>(0)))>
+    static constexpr Type static_query_v = Executor::query(locality_t());
+
+  // Indicates that submitted functions may run on any of the context's threads.
+  static constexpr std::size_t any = static_cast<std::size_t>(-1);
+
+  // The node is an index into the execution context's own grouping of threads,
+  // such as the NUMA nodes on which a thread pool's threads are placed.
+  constexpr locality_t() = default;
+  constexpr explicit locality_t(std::size_t node) : node_(node) {}
+
+  constexpr locality_t operator()(std::size_t node) const
+  {
+    return locality_t(node);
+  }
+
+  constexpr std::size_t node() const { return node_; }
+
+  friend constexpr bool operator==(const locality_t& a, const locality_t& b) noexcept
+  {
+    return a.node_ == b.node_;
+  }
+
+  friend constexpr bool operator!=(const locality_t& a, const locality_t& b) noexcept
+  {
+    return !(a == b);
+  }
+
+private:
+  std::size_t node_ = any;
+};
+
+constexpr locality_t locality;
+
+} // namespace execution
+} // inline namespace executors_v1
+} // namespace experimental
+} // namespace std
+
+#endif // STD_EXPERIMENTAL_BITS_LOCALITY_H
@@ -0,0 +1,54 @@
+#ifndef STD_EXPERIMENTAL_BITS_PRIORITY_H
+#define STD_EXPERIMENTAL_BITS_PRIORITY_H
+
+namespace std {
+namespace experimental {
+inline namespace executors_v1 {
+namespace execution {
+
+struct priority_t
+{
+  static constexpr bool is_requirable = true;
+  static constexpr bool is_preferable = true;
+
+  using polymorphic_query_result_type = priority_t;
+
+  template<class Executor, class Type = decltype(Executor::query(*static_cast<priority_t*>(0)))>
+    static constexpr Type static_query_v = Executor::query(priority_t());
+
+  // Functions of higher priority are run ahead of those of lower priority
+  // that are queued at the same time.
+  enum level { low, normal, high };
+
+  constexpr priority_t() = default;
+  constexpr explicit priority_t(level l) : level_(l) {}
+
+  constexpr priority_t operator()(level l) const
+  {
+    return priority_t(l);
+  }
+
+  constexpr level value() const { return level_; }
+
+  friend constexpr bool operator==(const priority_t& a, const priority_t& b) noexcept
+  {
+    return a.level_ == b.level_;
+  }
+
+  friend constexpr bool operator!=(const priority_t& a, const priority_t& b) noexcept
+  {
+    return !(a == b);
+  }
+
+private:
+  level level_ = normal;
+};
+
+constexpr priority_t priority;
+
+} // namespace execution
+} // inline namespace executors_v1
+} // namespace experimental
+} // namespace std
+
+#endif // STD_EXPERIMENTAL_BITS_PRIORITY_H
@@ -1,16 +1,35 @@
 #ifndef STD_EXPERIMENTAL_BITS_STATIC_THREAD_POOL_H
 #define STD_EXPERIMENTAL_BITS_STATIC_THREAD_POOL_H
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstddef>
+#include <cstring>
 #include <experimental/future>
+#include <experimental/bits/completion_latch.h>
+#include <experimental/bits/erased_function.h>
+#include <fstream>
+#include <limits>
 #include <list>
 #include <memory>
 #include <mutex>
 #include <new>
+#include <string>
 #include <thread>
 #include <tuple>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+# include <intrin.h>
+#endif
+
+#if defined(__linux__)
+# include <pthread.h>
+# include <sched.h>
+#endif
 
 namespace std {
 namespace experimental {
@@ -20,20 +39,31 @@ class static_thread_pool
 {
   template<class, class T, class U> struct dependent_is_same : std::is_same<T, U> {};
 
+  // Executor properties that accompany each submitted function.
+  struct attributes
+  {
+    execution::bulk_chunk_size_t chunk_;
+    execution::locality_t locality_;
+    execution::priority_t priority_;
+    stop_token stop_;
+  };
+
   template<class Blocking, class Continuation, class Work, class ProtoAllocator>
   class executor_impl
   {
     friend class static_thread_pool;
     static_thread_pool* pool_;
     ProtoAllocator allocator_;
+    attributes attributes_;
 
-    executor_impl(static_thread_pool* p, const ProtoAllocator& a) noexcept
-      : pool_(p), allocator_(a) { pool_->work_up(Work{}); }
+    executor_impl(static_thread_pool* p, const ProtoAllocator& a, const attributes& attrs) noexcept
+      : pool_(p), allocator_(a), attributes_(attrs) { pool_->work_up(Work{}); }
 
   public:
     using shape_type = std::size_t;
 
-    executor_impl(const executor_impl& other) noexcept : pool_(other.pool_) { pool_->work_up(Work{}); }
+    executor_impl(const executor_impl& other) noexcept
+      : pool_(other.pool_), allocator_(other.allocator_), attributes_(other.attributes_) { pool_->work_up(Work{}); }
     ~executor_impl() { pool_->work_down(Work{}); }
 
     // Associated execution context.
@@ -41,25 +71,25 @@ class static_thread_pool
 
     // Blocking modes.
     executor_impl<execution::blocking_t::never_t, Continuation, Work, ProtoAllocator>
-      require(execution::blocking_t::never_t) const { return {pool_, allocator_}; };
+      require(execution::blocking_t::never_t) const { return {pool_, allocator_, attributes_}; };
     executor_impl<execution::blocking_t::possibly_t, Continuation, Work, ProtoAllocator>
-      require(execution::blocking_t::possibly_t) const { return {pool_, allocator_}; };
+      require(execution::blocking_t::possibly_t) const { return {pool_, allocator_, attributes_}; };
     executor_impl<execution::blocking_t::always_t, Continuation, Work, ProtoAllocator>
-      require(execution::blocking_t::always_t) const { return {pool_, allocator_}; };
+      require(execution::blocking_t::always_t) const { return {pool_, allocator_, attributes_}; };
     static constexpr execution::blocking_t query(execution::blocking_t) { return Blocking{}; }
 
     // Continuation hint.
     executor_impl<Blocking, execution::relationship_t::fork_t, Work, ProtoAllocator>
-      require(execution::relationship_t::fork_t) const { return {pool_, allocator_}; };
+      require(execution::relationship_t::fork_t) const { return {pool_, allocator_, attributes_}; };
     executor_impl<Blocking, execution::relationship_t::continuation_t, Work, ProtoAllocator>
-      require(execution::relationship_t::continuation_t) const { return {pool_, allocator_}; };
+      require(execution::relationship_t::continuation_t) const { return {pool_, allocator_, attributes_}; };
     static constexpr execution::relationship_t query(execution::relationship_t) { return Continuation{}; }
 
     // Work tracking.
     executor_impl<Blocking, Continuation, execution::outstanding_work_t::untracked_t, ProtoAllocator>
-      require(execution::outstanding_work_t::untracked_t) const { return {pool_, allocator_}; };
+      require(execution::outstanding_work_t::untracked_t) const { return {pool_, allocator_, attributes_}; };
     executor_impl<Blocking, Continuation, execution::outstanding_work_t::tracked_t, ProtoAllocator>
-      require(execution::outstanding_work_t::tracked_t) const { return {pool_, allocator_}; };
+      require(execution::outstanding_work_t::tracked_t) const { return {pool_, allocator_, attributes_}; };
     static constexpr execution::outstanding_work_t query(execution::outstanding_work_t) { return Work{}; }
 
     // Bulk forward progress.
@@ -70,13 +100,49 @@ class static_thread_pool
 
     // Allocator.
     executor_impl<Blocking, Continuation, Work, std::allocator<void>>
-      require(const execution::allocator_t<void>&) const { return {pool_, std::allocator<void>{}}; };
+      require(const execution::allocator_t<void>&) const { return {pool_, std::allocator<void>{}, attributes_}; };
     template<class NewProtoAllocator>
       executor_impl<Blocking, Continuation, Work, NewProtoAllocator>
-        require(const execution::allocator_t<NewProtoAllocator>& a) const { return {pool_, a.value()}; }
+        require(const execution::allocator_t<NewProtoAllocator>& a) const { return {pool_, a.value(), attributes_}; }
     ProtoAllocator query(const execution::allocator_t<ProtoAllocator>&) const noexcept { return allocator_; }
     ProtoAllocator query(const execution::allocator_t<void>&) const noexcept { return allocator_; }
 
+    // Partitioning of bulk shapes.
+    executor_impl require(const execution::bulk_chunk_size_t& c) const
+    {
+      attributes attrs(attributes_);
+      attrs.chunk_ = c;
+      return {pool_, allocator_, attrs};
+    }
+    execution::bulk_chunk_size_t query(const execution::bulk_chunk_size_t&) const noexcept { return attributes_.chunk_; }
+
+    // Placement on the threads of a NUMA node.
+    executor_impl require(const execution::locality_t& l) const
+    {
+      attributes attrs(attributes_);
+      attrs.locality_ = l;
+      return {pool_, allocator_, attrs};
+    }
+    execution::locality_t query(const execution::locality_t&) const noexcept { return attributes_.locality_; }
+
+    // Ordering relative to other queued functions.
+    executor_impl require(const execution::priority_t& p) const
+    {
+      attributes attrs(attributes_);
+      attrs.priority_ = p;
+      return {pool_, allocator_, attrs};
+    }
+    execution::priority_t query(const execution::priority_t&) const noexcept { return attributes_.priority_; }
+
+    // Cancellation of functions that have not yet started.
+    executor_impl require(const execution::cancellation_t& c) const
+    {
+      attributes attrs(attributes_);
+      attrs.stop_ = c.value();
+      return {pool_, allocator_, attrs};
+    }
+    execution::cancellation_t query(const execution::cancellation_t&) const noexcept { return execution::cancellation_t(attributes_.stop_); }
+
     bool running_in_this_thread() const noexcept { return pool_->running_in_this_thread(); }
 
     friend bool operator==(const executor_impl& a, const executor_impl& b) noexcept
@@ -91,23 +157,44 @@ class static_thread_pool
 
     template<class Function> void execute(Function f) const
     {
-      pool_->execute(Blocking{}, Continuation{}, allocator_, std::move(f));
+      pool_->execute(Blocking{}, Continuation{}, allocator_, attributes_, std::move(f));
+    }
+
+    // Submits a function on behalf of the polymorphic executor.
+    void execute_erased(const execution::executor_impl::erased_function& f) const
+    {
+      pool_->execute_erased(Blocking{}, Continuation{}, allocator_, attributes_, f);
+    }
+
+    // Submits a function to run no earlier than the given time. Never blocks,
+    // whatever the blocking property.
+    template<class Clock, class Duration, class Function>
+    void execute_at(const std::chrono::time_point<Clock, Duration>& t, Function f) const
+    {
+      pool_->execute_at(allocator_, attributes_, static_thread_pool::to_steady(t), std::move(f));
+    }
+
+    template<class Rep, class Period, class Function>
+    void execute_after(const std::chrono::duration<Rep, Period>& d, Function f) const
+    {
+      pool_->execute_at(allocator_, attributes_, std::chrono::steady_clock::now()
+          + std::chrono::ceil<std::chrono::steady_clock::duration>(d), std::move(f));
     }
 
     template<class Function> auto twoway_execute(Function f) const -> future<decltype(f())>
     {
-      return pool_->twoway_execute(Blocking{}, Continuation{}, allocator_, std::move(f));
+      return pool_->twoway_execute(Blocking{}, Continuation{}, allocator_, attributes_, std::move(f));
     }
 
     template<class Function, class SharedFactory> void bulk_execute(Function f, std::size_t n, SharedFactory sf) const
     {
-      pool_->bulk_execute(Blocking{}, Continuation{}, allocator_, std::move(f), n, std::move(sf));
+      pool_->bulk_execute(Blocking{}, Continuation{}, allocator_, attributes_, std::move(f), n, std::move(sf));
     }
 
     template<class Function, class ResultFactory, class SharedFactory>
     auto bulk_twoway_execute(Function f, std::size_t n, ResultFactory rf, SharedFactory sf) const -> future<decltype(rf())>
     {
-      return pool_->bulk_twoway_execute(Blocking{}, Continuation{}, allocator_, std::move(f), n, std::move(rf), std::move(sf));
+      return pool_->bulk_twoway_execute(Blocking{}, Continuation{}, allocator_, attributes_, std::move(f), n, std::move(rf), std::move(sf));
     }
   };
 
@@ -119,10 +206,106 @@ public:
       std::allocator<void>
     >;
 
+  // Strategies for distributing submitted functions across the pool's threads.
+  enum class scheduling
+  {
+    shared_queue, // All threads share a single queue.
+    work_stealing // Each thread owns a queue, and idle threads steal from their peers.
+  };
+
+  // How long an idle thread keeps polling for new work before it parks.
+  struct idle_policy
+  {
+    // Number of polls separated by a CPU pause instruction.
+    std::size_t spin = 0;
+
+    // Number of further polls separated by a yield to the operating system.
+    std::size_t yield = 0;
+  };
+
+  // How wait() waits for the pool.
+  enum class wait_mode
+  {
+    join, // The waiting thread blocks until the pool's threads have exited.
+    help  // The waiting thread runs queued functions until the pool is quiescent.
+  };
+
+  // Scheduler configuration.
+  struct options
+  {
+    // Strategy used to distribute functions across threads.
+    scheduling schedule = scheduling::shared_queue;
+
+    // With work stealing, whether idle threads may steal functions submitted
+    // with relationship.continuation before the submitting function returns.
+    bool steal_continuations = false;
+
+    // Behaviour of threads that run out of work. Parks immediately by default.
+    idle_policy idle;
+
+    // CPUs on which to run the pool's threads, grouped by NUMA node. Threads
+    // are divided evenly between the nodes, in order, and each is pinned to its
+    // node's CPUs. Empty leaves placement to the operating system.
+    std::vector<std::vector<int>> nodes;
+
+    // Number of times that queued functions may be passed over in favour of
+    // functions of higher priority before one of them is run first.
+    std::size_t starvation_limit = 16;
+  };
+
+  // Returns the system's NUMA nodes and their CPUs, suitable for options::nodes.
+  // Nodes without CPUs are omitted, so node numbers need not match the
+  // system's. Where the topology is unknown, reports a single node containing
+  // every CPU.
+  static std::vector<std::vector<int>> numa_nodes()
+  {
+    std::vector<std::vector<int>> nodes;
+#if defined(__linux__)
+    // Online nodes need not be numbered contiguously.
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string list;
+    if (std::getline(online, list))
+    {
+      for (int node : parse_cpu_list(list))
+      {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::vector<int> cpus;
+        if (std::getline(in, list))
+          cpus = parse_cpu_list(list);
+        if (!cpus.empty())
+          nodes.emplace_back(std::move(cpus));
+      }
+    }
+#endif
+    if (nodes.empty())
+    {
+      nodes.emplace_back();
+      for (unsigned i = 0, n = std::thread::hardware_concurrency(); i < n; ++i)
+        nodes.back().push_back(static_cast<int>(i));
+    }
+    return nodes;
+  }
+
   explicit static_thread_pool(std::size_t threads)
+    : static_thread_pool(threads, options{})
+  {
+  }
+
+  static_thread_pool(std::size_t threads, scheduling s)
+    : static_thread_pool(threads, [s]{ options o; o.schedule = s; return o; }())
+  {
+  }
+
+  static_thread_pool(std::size_t threads, const options& o)
+    : options_(o), thread_count_(threads), nodes_(new node_state[o.nodes.size()])
   {
     for (std::size_t i = 0; i < threads; ++i)
-      threads_.emplace_back([this]{ attach(); });
+    {
+      std::size_t node = execution::locality_t::any;
+      if (!options_.nodes.empty())
+        ++nodes_[node = i * options_.nodes.size() / threads].threads_;
+      threads_.emplace_back([this, node]{ attach(node); });
+    }
   }
 
   static_thread_pool(const static_thread_pool&) = delete;
@@ -132,34 +315,21 @@ public:
   {
     stop();
     wait();
+    while (worker_state* worker = workers_.load())
+    {
+      workers_ = worker->next_;
+      delete worker;
+    }
   }
 
   executor_type executor() noexcept
   {
-    return executor_type{this, std::allocator<void>{}};
+    return executor_type{this, std::allocator<void>{}, attributes{}};
   }
 
   void attach()
   {
-    thread_private_state private_state{this};
-    for (std::unique_lock<std::mutex> lock(mutex_);;)
-    {
-      condition_.wait(lock, [this]{ return stopped_ || work_ == 0 || head_; });
-      if (stopped_ || (work_ == 0 && !head_)) return;
-      func_base* func = head_.release();
-      head_ = std::move(func->next_);
-      tail_ = head_ ? tail_ : &head_;
-      lock.unlock();
-      func->call();
-      lock.lock();
-      if (private_state.head_)
-      {
-        *tail_ = std::move(private_state.head_);
-        tail_ = private_state.tail_;
-        private_state.tail_ = &private_state.head_;
-        // TODO notify other threads if more than one in private queue
-      }
-    }
+    attach(execution::locality_t::any);
   }
 
   void stop()
@@ -170,20 +340,110 @@ public:
   }
 
   void wait()
+  {
+    wait(wait_mode::join);
+  }
+
+  void wait(wait_mode mode)
   {
     std::unique_lock<std::mutex> lock(mutex_);
     std::list<std::thread> threads(std::move(threads_));
-    if (!threads.empty())
+
+    // A helping thread releases the pool's own work even if the pool has no
+    // threads, so that it can drain the queue of a pool run only by attach().
+    if ((!threads.empty() || mode == wait_mode::help) && !waited_)
     {
+      waited_ = true;
       --work_;
       condition_.notify_all();
-      lock.unlock();
-      for (auto& t : threads)
-        t.join();
+    }
+    lock.unlock();
+    if (mode == wait_mode::help)
+      attach(execution::locality_t::any);
+    for (auto& t : threads)
+      t.join();
+  }
+
+  // Runs functions from the pool on the calling thread until the future is
+  // ready. A function that waits for other work of the same pool can use this
+  // to run that work, rather than block one of the threads it needs.
+  template<class R>
+  void run_until(const future<R>& f)
+  {
+    thread_private_state* private_state = thread_private_state::instance();
+    if (private_state && private_state->pool_ == this)
+      run_until(*private_state, f);
+    else
+    {
+      thread_private_state new_state{this, execution::locality_t::any};
+      run_until(new_state, f);
     }
   }
 
 private:
+  void attach(std::size_t node)
+  {
+    if (node != execution::locality_t::any)
+    {
+      pin_this_thread(options_.nodes[node]);
+      node_cache::bind_this_thread(node);
+    }
+
+    thread_private_state private_state{this, node};
+    ++attached_;
+    if (options_.schedule == scheduling::work_stealing)
+      private_state.worker_ = acquire_worker();
+    while (func_base::pointer func = next_function(private_state))
+    {
+      func.release()->call();
+      flush_private_queue(private_state);
+    }
+    if (private_state.worker_)
+      release_worker(*private_state.worker_);
+    --attached_;
+  }
+
+  // Restricts the calling thread to the given CPUs, where supported.
+  static void pin_this_thread(const std::vector<int>& cpus) noexcept
+  {
+#if defined(__linux__) && defined(CPU_SET)
+    if (cpus.empty())
+      return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+      if (cpu >= 0 && cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpus;
+#endif
+  }
+
+  // Parses a sysfs list of CPU or node ranges, such as "0-3,8-11".
+  static std::vector<int> parse_cpu_list(const std::string& list)
+  {
+    std::vector<int> cpus;
+    for (std::size_t pos = 0; pos < list.size();)
+    {
+      std::size_t end = std::min(list.find(',', pos), list.size());
+      std::string range = list.substr(pos, end - pos);
+      std::size_t dash = range.find('-');
+      try
+      {
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+          cpus.push_back(cpu);
+      }
+      catch (...)
+      {
+      }
+      pos = end + 1;
+    }
+    return cpus;
+  }
+
   template<class Function>
   static void invoke(Function& f) noexcept // Exceptions mean std::terminate.
   {
@@ -199,258 +459,956 @@ private:
     virtual void call() = 0;
     virtual void destroy() = 0;
 
-    pointer next_;
+    func_base* next_{nullptr};
+    func_base* prev_{nullptr};
   };
 
-  template<class Function, class ProtoAllocator>
-  struct func : func_base
+  // Intrusive double-ended queue of function objects.
+  class func_queue
   {
-    explicit func(Function f, const ProtoAllocator& a) : function_(std::move(f)), allocator_(a) {}
+  public:
+    func_queue() = default;
+    func_queue(const func_queue&) = delete;
+    func_queue& operator=(const func_queue&) = delete;
+    ~func_queue() { while (pop_front()) {} }
 
-    static func_base::pointer create(Function f, const ProtoAllocator& a)
-		{
-			typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<func> allocator(a);
-			func* raw_p = allocator.allocate(1);
-			try
-			{
-        func* p = new (raw_p) func(std::move(f), a);
-				return func_base::pointer(p);
-			}
-			catch (...)
-			{
-				allocator.deallocate(raw_p, 1);
-				throw;
-			}
-		}
+    bool empty() const noexcept { return !head_; }
+    std::size_t size() const noexcept { return size_; }
+    func_base* front() const noexcept { return head_; }
 
-    virtual void call()
+    void push_front(func_base::pointer f) noexcept
     {
-      func_base::pointer fp(this);
-      Function f(std::move(function_));
-      fp.reset();
-      static_thread_pool::invoke(f);
+      func_base* p = f.release();
+      p->prev_ = nullptr;
+      p->next_ = head_;
+      (head_ ? head_->prev_ : tail_) = p;
+      head_ = p;
+      ++size_;
     }
 
-    virtual void destroy()
+    void push_back(func_base::pointer f) noexcept
     {
-      func* p = this;
-      p->~func();
-      allocator_.deallocate(p, 1);
+      func_base* p = f.release();
+      p->next_ = nullptr;
+      p->prev_ = tail_;
+      (tail_ ? tail_->next_ : head_) = p;
+      tail_ = p;
+      ++size_;
     }
 
-    Function function_;
-    typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<func> allocator_;
-  };
+    func_base::pointer pop_front() noexcept
+    {
+      func_base* p = head_;
+      if (!p) return nullptr;
+      head_ = p->next_;
+      (head_ ? head_->prev_ : tail_) = nullptr;
+      p->next_ = nullptr;
+      --size_;
+      return func_base::pointer(p);
+    }
 
-  struct thread_private_state
-  {
-    static_thread_pool* pool_;
-    func_base::pointer head_;
-    func_base::pointer* tail_{&head_};
-    thread_private_state* prev_state_{instance()};
+    func_base::pointer pop_back() noexcept
+    {
+      func_base* p = tail_;
+      if (!p) return nullptr;
+      tail_ = p->prev_;
+      (tail_ ? tail_->next_ : head_) = nullptr;
+      p->prev_ = nullptr;
+      --size_;
+      return func_base::pointer(p);
+    }
 
-    explicit thread_private_state(static_thread_pool* p) : pool_(p) { instance() = this; }
-    ~thread_private_state() { instance() = prev_state_; }
+    // Moves all functions from other to the front of this queue.
+    void splice_front(func_queue& other) noexcept
+    {
+      if (other.empty()) return;
+      other.tail_->next_ = head_;
+      (head_ ? head_->prev_ : tail_) = other.tail_;
+      head_ = other.head_;
+      size_ += other.size_;
+      other.head_ = other.tail_ = nullptr;
+      other.size_ = 0;
+    }
 
-    static thread_private_state*& instance()
+    // Moves all functions from other to the back of this queue.
+    void splice_back(func_queue& other) noexcept
     {
-      static thread_local thread_private_state* p;
-      return p;
+      if (other.empty()) return;
+      other.head_->prev_ = tail_;
+      (tail_ ? tail_->next_ : head_) = other.head_;
+      tail_ = other.tail_;
+      size_ += other.size_;
+      other.head_ = other.tail_ = nullptr;
+      other.size_ = 0;
     }
+
+    // Moves up to n functions from the front of this queue to the back of other.
+    void split_front(std::size_t n, func_queue& other) noexcept
+    {
+      while (n-- > 0 && !empty())
+        other.push_back(pop_front());
+    }
+
+  private:
+    func_base* head_{nullptr};
+    func_base* tail_{nullptr};
+    std::size_t size_{0};
   };
 
-  bool running_in_this_thread() const noexcept
+  // Bounded lock-free multi-producer/multi-consumer queue. Based on Dmitry
+  // Vyukov's bounded MPMC queue.
+  template<class T>
+  class bounded_queue
   {
-    if (thread_private_state* private_state = thread_private_state::instance())
-      if (private_state->pool_ == this)
-        return true;
-    return false;
-  }
+  public:
+    static constexpr std::size_t capacity = 1024; // Must be a power of two.
 
-  template<class Blocking, class Continuation, class ProtoAllocator, class Function>
-  void execute(Blocking, Continuation, const ProtoAllocator& alloc, Function f)
-  {
-    if (std::is_same<Blocking, execution::blocking_t::possibly_t>::value)
+    bounded_queue() noexcept
     {
-      // Run immediately if already in the pool.
-      if (thread_private_state* private_state = thread_private_state::instance())
+      for (std::size_t i = 0; i < capacity; ++i)
+        cells_[i].sequence_.store(i, std::memory_order_relaxed);
+    }
+
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+
+    // Approximate, but a completed push is always observed.
+    bool empty() const noexcept { return head_.load() == tail_.load(); }
+
+    // Fails if the queue is full.
+    bool try_push(T value) noexcept
+    {
+      std::size_t pos = tail_.load(std::memory_order_relaxed);
+      for (;;)
       {
-        if (private_state->pool_ == this)
+        cell& c = cells_[pos & (capacity - 1)];
+        std::size_t seq = c.sequence_.load(std::memory_order_acquire);
+        std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq - pos);
+        if (diff == 0)
         {
-          static_thread_pool::invoke(f);
-          return;
+          if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          {
+            c.value_ = value;
+            c.sequence_.store(pos + 1, std::memory_order_release);
+            return true;
+          }
         }
+        else if (diff < 0)
+          return false;
+        else
+          pos = tail_.load(std::memory_order_relaxed);
       }
     }
 
-    func_base::pointer fp(func<Function, ProtoAllocator>::create(std::move(f), alloc));
-
-    if (std::is_same<Continuation, execution::relationship_t::continuation_t>::value)
+    // Fails if the queue is empty.
+    bool try_pop(T& value) noexcept
     {
-      // Push to thread-private queue if available.
-      if (thread_private_state* private_state = thread_private_state::instance())
+      std::size_t pos = head_.load(std::memory_order_relaxed);
+      for (;;)
       {
-        if (private_state->pool_ == this)
+        cell& c = cells_[pos & (capacity - 1)];
+        std::size_t seq = c.sequence_.load(std::memory_order_acquire);
+        std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+        if (diff == 0)
         {
-          *private_state->tail_ = std::move(fp);
-          private_state->tail_ = &(*private_state->tail_)->next_;
-          return;
+          if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          {
+            value = c.value_;
+            c.sequence_.store(pos + capacity, std::memory_order_release);
+            return true;
+          }
         }
+        else if (diff < 0)
+          return false;
+        else
+          pos = head_.load(std::memory_order_relaxed);
       }
     }
 
-    // Otherwise push to main queue.
-    std::unique_lock<std::mutex> lock(mutex_);
-    *tail_ = std::move(fp);
-    tail_ = &(*tail_)->next_;
-    condition_.notify_one();
-  }
+  private:
+    struct cell
+    {
+      std::atomic<std::size_t> sequence_;
+      T value_;
+    };
 
-  template<class Continuation, class ProtoAllocator, class Function>
-  void execute(execution::blocking_t::always_t, Continuation, const ProtoAllocator& alloc, Function f)
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    alignas(64) cell cells_[capacity];
+  };
+
+  // Used to submit single functions without taking the pool's mutex.
+  class injection_queue : public bounded_queue<func_base*>
   {
-    // Run immediately if already in the pool.
-    if (thread_private_state* private_state = thread_private_state::instance())
+  public:
+    ~injection_queue()
     {
-      if (private_state->pool_ == this)
-      {
-        static_thread_pool::invoke(f);
-        return;
-      }
+      while (func_base* f = try_pop())
+        f->destroy();
     }
 
-    // Otherwise, wrap the function with a promise that, when broken, will signal that the function is complete.
-    promise<void> promise;
-    future<void> future = promise.get_future();
-    this->execute(execution::blocking.never, Continuation{}, alloc, [f = std::move(f), p = std::move(promise)]() mutable { f(); });
-    future.wait();
-  }
-
-  template<class Blocking, class Continuation, class ProtoAllocator, class Function>
-  auto twoway_execute(Blocking, Continuation, const ProtoAllocator& alloc, Function f) -> future<decltype(f())>
-  {
-    packaged_task<decltype(f())()> task(std::move(f));
-    future<decltype(f())> future = task.get_future();
-    this->execute(Blocking{}, Continuation{}, alloc, std::move(task));
-    return future;
-  }
+    using bounded_queue<func_base*>::try_pop;
 
-  template<class Function, class SharedFactory>
-  struct bulk_state
-  {
-    Function f_;
-    decltype(std::declval<SharedFactory>()()) ss_;
-    bulk_state(Function f, SharedFactory sf) : f_(std::move(f)), ss_(sf()) {}
-    void operator()(std::size_t i) { f_(i, ss_); }
+    // Returns null if the queue is empty.
+    func_base* try_pop() noexcept
+    {
+      func_base* f = nullptr;
+      return try_pop(f) ? f : nullptr;
+    }
   };
 
-  template<class Blocking, class Continuation, class ProtoAllocator, class Function, class SharedFactory>
-  void bulk_execute(Blocking, Continuation, const ProtoAllocator& alloc, Function f, std::size_t n, SharedFactory sf)
+  // Recycles the memory of small function objects when the executor uses
+  // std::allocator. Freed blocks go to a per-thread cache, and overflow to a
+  // cache shared by all threads, so that steady-state submission does not
+  // allocate even when functions are submitted and run on different threads.
+  // Threads pinned to a NUMA node share a separate cache, so that their blocks
+  // stay in memory local to the node. Each block records the cache of the
+  // thread that first touched it, and returns there when freed, whichever
+  // thread frees it.
+  class node_cache
   {
-    typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<char> alloc2(alloc);
-    auto shared_state = std::allocate_shared<bulk_state<Function, SharedFactory>>(alloc2, std::move(f), std::move(sf));
+  public:
+    static constexpr std::size_t block_size = 128;
 
-    func_base::pointer head;
-    func_base::pointer* tail{&head};
-    for (std::size_t i = 0; i < n; ++i)
+    // Functions bound to a node take blocks from that node's cache, even when
+    // submitted from a thread of another node. A block is allocated by the
+    // submitting thread only once that cache is empty, and then belongs to
+    // the submitting thread's cache.
+    static void* allocate(std::size_t node = execution::locality_t::any)
     {
-      auto indexed_f = [shared_state, i]() mutable { (*shared_state)(i); };
-      *tail = func_base::pointer(func<decltype(indexed_f), ProtoAllocator>::create(std::move(indexed_f), alloc));
-      tail = &(*tail)->next_;
+      std::size_t index = node == execution::locality_t::any ? bound_node() : cache_index(node);
+      if (index == bound_node())
+        if (node_cache* cache = instance())
+          if (cache->size_ > 0)
+            return cache->blocks_[--cache->size_];
+      void* p = nullptr;
+      if (shared(index).try_pop(p))
+        return p;
+      if (!(p = new_block(bound_node())))
+        throw std::bad_alloc();
+      return p;
     }
 
-    if (std::is_same<Continuation, execution::relationship_t::continuation_t>::value)
+    static void deallocate(void* p) noexcept
     {
-      // Push to thread-private queue if available.
-      if (thread_private_state* private_state = thread_private_state::instance())
+      std::size_t index = home(p);
+      if (index == bound_node())
       {
-        if (private_state->pool_ == this)
+        if (node_cache* cache = instance())
         {
-          *private_state->tail_ = std::move(head);
-          private_state->tail_ = tail;
-          return;
+          if (cache->size_ < capacity)
+          {
+            cache->blocks_[cache->size_++] = p;
+            return;
+          }
         }
       }
+      if (!shared(index).try_push(p))
+        delete_block(p);
     }
 
-    // Otherwise push to main queue.
-    std::unique_lock<std::mutex> lock(mutex_);
-    *tail_ = std::move(head);
-    tail_ = tail;
-    condition_.notify_all();
-  }
+    // Associates the calling thread with a NUMA node's shared cache, and
+    // stocks that cache with blocks first touched by the calling thread, so
+    // that under first-touch placement they are local to the node.
+    static void bind_this_thread(std::size_t node) noexcept
+    {
+      bound_node() = cache_index(node);
+      for (std::size_t i = 0; i < capacity; ++i)
+      {
+        void* p = new_block(bound_node());
+        if (!p)
+          break;
+        std::memset(p, 0, block_size);
+        if (!shared(bound_node()).try_push(p))
+        {
+          delete_block(p);
+          break;
+        }
+      }
+    }
 
-  template<class Continuation, class ProtoAllocator, class Function, class SharedFactory>
-  void bulk_execute(execution::blocking_t::always_t, Continuation, const ProtoAllocator& alloc, Function f, std::size_t n, SharedFactory sf)
-  {
-    // Wrap the function with a promise that, when broken, will signal that the function is complete.
-    promise<void> promise;
-    future<void> future = promise.get_future();
-    auto wrapped_f = [f = std::move(f), p = std::move(promise)](std::size_t n, auto& s) mutable { f(n, s); };
-    this->bulk_execute(execution::blocking.never, Continuation{}, alloc, std::move(wrapped_f), n, std::move(sf));
-    future.wait();
-  }
+  private:
+    static constexpr std::size_t capacity = 64;
+    static constexpr std::size_t max_nodes = 64;
 
-  template<class Blocking, class Continuation, class ProtoAllocator, class Function, class ResultFactory, class SharedFactory>
-  auto bulk_twoway_execute(Blocking, Continuation, const ProtoAllocator& alloc, Function f, std::size_t n, ResultFactory rf, SharedFactory sf)
-    -> typename std::enable_if<is_same<decltype(rf()), void>::value, future<void>>::type
-  {
-    // Wrap the shared state so that we can capture and return the result.
-    typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<char> alloc2(alloc);
-    auto shared_state = std::allocate_shared<
-        std::tuple<
-          std::atomic<std::size_t>, // Number of incomplete functions.
-          decltype(sf()), // Underlying shared state.
-          std::atomic<std::size_t>, // Number of exceptions raised.
-          std::exception_ptr, // First exception raised.
-          promise<void> // Promise to receive result
-        >>(alloc2, n, sf(), 0, nullptr, promise<void>());
-    future<void> future = std::get<4>(*shared_state).get_future();
+    enum state_type { uninitialised, alive, destroyed };
 
-    // Convert to a one way bulk operation.
-    this->bulk_execute(Blocking{}, Continuation{}, alloc,
-        [f = std::move(f)](auto i, auto& s) mutable
-        {
-          try
-          {
-            f(i, std::get<1>(*s));
-          }
-          catch (...)
-          {
-            if (std::get<2>(*s)++ == 0)
-              std::get<3>(*s) = std::current_exception();
-          }
-          if (--std::get<0>(*s) == 0)
-          {
-            if (std::get<3>(*s))
-              std::get<4>(*s).set_exception(std::get<3>(*s));
-            else
-              std::get<4>(*s).set_value();
-          }
-        }, n, [shared_state]{ return shared_state; });
+    explicit node_cache(state_type& state) noexcept : state_(state) { state_ = alive; }
+    node_cache(const node_cache&) = delete;
+    node_cache& operator=(const node_cache&) = delete;
 
-    return future;
-  }
+    ~node_cache()
+    {
+      state_ = destroyed;
+      while (size_ > 0)
+        if (!shared(bound_node()).try_push(blocks_[--size_]))
+          delete_block(blocks_[size_]);
+    }
 
-  template<class Blocking, class Continuation, class ProtoAllocator, class Function, class ResultFactory, class SharedFactory>
-  auto bulk_twoway_execute(Blocking, Continuation, const ProtoAllocator& alloc, Function f, std::size_t n, ResultFactory rf, SharedFactory sf)
-    -> typename std::enable_if<!is_same<decltype(rf()), void>::value, future<decltype(rf())>>::type
-  {
-    // Wrap the shared state so that we can capture and return the result.
-    typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<char> alloc2(alloc);
-    auto shared_state = std::allocate_shared<
-        std::tuple<
-          std::atomic<std::size_t>, // Number of incomplete functions.
-          decltype(rf()), // Result.
-          decltype(sf()), // Underlying shared state.
-          std::atomic<std::size_t>, // Number of exceptions raised.
-          std::exception_ptr, // First exception raised.
-          promise<decltype(rf())> // Promise to receive result
-        >>(alloc2, n, rf(), sf(), 0, nullptr, promise<decltype(rf())>());
+    // Each block is preceded by the index of the cache it belongs to.
+    static constexpr std::size_t header_size = alignof(std::max_align_t);
+
+    // Returns null if memory is exhausted.
+    static void* new_block(std::size_t index) noexcept
+    {
+      void* raw_p = ::operator new(header_size + block_size, std::nothrow);
+      if (!raw_p)
+        return nullptr;
+      new (raw_p) std::size_t(index);
+      return static_cast<char*>(raw_p) + header_size;
+    }
+
+    static void delete_block(void* p) noexcept
+    {
+      ::operator delete(static_cast<char*>(p) - header_size);
+    }
+
+    static std::size_t home(void* p) noexcept
+    {
+      return *std::launder(reinterpret_cast<std::size_t*>(static_cast<char*>(p) - header_size));
+    }
+
+    // Returns null once the calling thread's cache has been destroyed.
+    static node_cache* instance() noexcept
+    {
+      static thread_local state_type state = uninitialised;
+      if (state == destroyed)
+        return nullptr;
+      static thread_local node_cache cache(state);
+      return &cache;
+    }
+
+    static std::size_t cache_index(std::size_t node) noexcept
+    {
+      return node < max_nodes ? node + 1 : 0;
+    }
+
+    // Index of the calling thread's shared cache. Zero is used by threads
+    // that are not bound to a node.
+    static std::size_t& bound_node() noexcept
+    {
+      static thread_local std::size_t node = 0;
+      return node;
+    }
+
+    // Intentionally never destroyed, as threads may return blocks to them
+    // during static destruction. Created on first use.
+    static bounded_queue<void*>& shared(std::size_t index)
+    {
+      static std::atomic<bounded_queue<void*>*> caches[max_nodes + 1];
+      bounded_queue<void*>* blocks = caches[index].load(std::memory_order_acquire);
+      if (!blocks)
+      {
+        bounded_queue<void*>* new_blocks = new bounded_queue<void*>;
+        if (caches[index].compare_exchange_strong(blocks, new_blocks, std::memory_order_acq_rel))
+          blocks = new_blocks;
+        else
+          delete new_blocks;
+      }
+      return *blocks;
+    }
+
+    state_type& state_;
+    void* blocks_[capacity];
+    std::size_t size_{0};
+  };
+
+  template<class ProtoAllocator>
+  struct is_std_allocator : std::false_type {};
+
+  template<class T>
+  struct is_std_allocator<std::allocator<T>> : std::true_type {};
+
+  template<class Function, class ProtoAllocator>
+  struct func : func_base
+  {
+    explicit func(Function f, const ProtoAllocator& a) : function_(std::move(f)), allocator_(a) {}
+
+    using allocator_type = typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<func>;
+
+    static constexpr bool recycled()
+    {
+      return is_std_allocator<ProtoAllocator>::value
+        && sizeof(func) <= node_cache::block_size
+        && alignof(func) <= alignof(std::max_align_t);
+    }
+
+    static func_base::pointer create(Function f, const ProtoAllocator& a, std::size_t node = execution::locality_t::any)
+    {
+      allocator_type allocator(a);
+      func* raw_p = recycled() ? static_cast<func*>(node_cache::allocate(node)) : allocator.allocate(1);
+      try
+      {
+        func* p = new (raw_p) func(std::move(f), a);
+        return func_base::pointer(p);
+      }
+      catch (...)
+      {
+        deallocate(allocator, raw_p);
+        throw;
+      }
+    }
+
+    static void deallocate(allocator_type& allocator, func* p)
+    {
+      if (recycled())
+        node_cache::deallocate(p);
+      else
+        allocator.deallocate(p, 1);
+    }
+
+    virtual void call()
+    {
+      func_base::pointer fp(this);
+      Function f(std::move(function_));
+      fp.reset();
+      static_thread_pool::invoke(f);
+    }
+
+    virtual void destroy()
+    {
+      func* p = this;
+      allocator_type allocator(std::move(allocator_));
+      p->~func();
+      deallocate(allocator, p);
+    }
+
+    Function function_;
+    allocator_type allocator_;
+  };
+
+  // A function whose type was erased by the polymorphic executor, moved into
+  // the same allocation as its node.
+  template<class ProtoAllocator>
+  struct erased_func : func_base
+  {
+    using block = std::max_align_t;
+    using allocator_type = typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<block>;
+
+    erased_func(const execution::executor_impl::erased_function& f, void* storage,
+        const attributes& attrs, const ProtoAllocator& a, std::size_t blocks)
+      : function_(f.move_to(storage)), stop_(attrs.stop_), allocator_(a), blocks_(blocks) {}
+
+    static bool recycled(std::size_t blocks)
+    {
+      return is_std_allocator<ProtoAllocator>::value && blocks * sizeof(block) <= node_cache::block_size;
+    }
+
+    static func_base::pointer create(const execution::executor_impl::erased_function& f,
+        const ProtoAllocator& a, const attributes& attrs)
+    {
+      std::size_t blocks = (f.size_after(sizeof(erased_func)) + sizeof(block) - 1) / sizeof(block);
+      allocator_type allocator(a);
+      void* raw_p = recycled(blocks) ? node_cache::allocate(attrs.locality_.node()) : allocator.allocate(blocks);
+      try
+      {
+        return func_base::pointer(new (raw_p) erased_func(f, f.address_after(raw_p, sizeof(erased_func)), attrs, a, blocks));
+      }
+      catch (...)
+      {
+        deallocate(allocator, raw_p, blocks);
+        throw;
+      }
+    }
+
+    static void deallocate(allocator_type& allocator, void* p, std::size_t blocks)
+    {
+      if (recycled(blocks))
+        node_cache::deallocate(p);
+      else
+        allocator.deallocate(static_cast<block*>(p), blocks);
+    }
+
+    virtual void call()
+    {
+      func_base::pointer fp(this);
+      if (!stop_.stop_requested())
+        static_thread_pool::invoke(function_);
+    }
+
+    virtual void destroy()
+    {
+      function_.destroy();
+      allocator_type allocator(std::move(allocator_));
+      std::size_t blocks = blocks_;
+      this->~erased_func();
+      deallocate(allocator, this, blocks);
+    }
+
+    execution::executor_impl::erased_function function_;
+    stop_token stop_;
+    allocator_type allocator_;
+    std::size_t blocks_;
+  };
+
+  // Queue owned by a single thread when using the work-stealing scheduler. The
+  // owner pushes and pops at the front, while idle threads steal from the back.
+  struct worker_state
+  {
+    std::mutex mutex_;
+    func_queue queue_;
+    func_queue continuations_; // Not yet spliced into queue_, but may be stolen.
+    std::atomic<std::size_t> size_{0};
+    bool in_use_{false};
+    worker_state* next_{nullptr};
+  };
+
+  // Functions that may only run on the threads placed on one NUMA node.
+  struct node_state
+  {
+    func_queue queue_; // Protected by the pool's mutex_.
+    std::atomic<std::size_t> size_{0};
+    std::size_t threads_{0};
+  };
+
+  // Functions submitted with a high or low priority. Normal priority
+  // functions use the pool's other queues.
+  struct level_queue
+  {
+    func_queue queue_; // Protected by the pool's mutex_.
+    std::atomic<std::size_t> size_{0};
+    std::atomic<std::size_t> skipped_{0}; // Times passed over since one last ran.
+  };
+
+  // A function waiting in the timer heap.
+  struct timer
+  {
+    std::chrono::steady_clock::time_point time_;
+    std::size_t sequence_; // Orders timers that expire at the same time.
+    func_base::pointer func_;
+    attributes attributes_;
+
+    // Orders the heap so that the earliest timer is at the front.
+    friend bool operator<(const timer& a, const timer& b) noexcept
+    {
+      return a.time_ > b.time_ || (a.time_ == b.time_ && a.sequence_ > b.sequence_);
+    }
+  };
+
+  struct thread_private_state
+  {
+    static_thread_pool* pool_;
+    std::size_t node_;
+    func_queue queue_;
+    worker_state* worker_{nullptr};
+    bool published_continuations_{false};
+    thread_private_state* prev_state_{instance()};
+
+    thread_private_state(static_thread_pool* p, std::size_t node) : pool_(p), node_(node) { instance() = this; }
+    ~thread_private_state() { instance() = prev_state_; }
+
+    static thread_private_state*& instance()
+    {
+      static thread_local thread_private_state* p;
+      return p;
+    }
+  };
+
+  bool running_in_this_thread() const noexcept
+  {
+    if (thread_private_state* private_state = thread_private_state::instance())
+      if (private_state->pool_ == this)
+        return true;
+    return false;
+  }
+
+  // Whether the calling thread is in the pool and may run functions bound to the node.
+  bool running_in_this_thread(std::size_t node) const noexcept
+  {
+    if (thread_private_state* private_state = thread_private_state::instance())
+      if (private_state->pool_ == this)
+        return node == execution::locality_t::any || private_state->node_ == node;
+    return false;
+  }
+
+  // Returns the node to whose threads functions submitted with the attributes
+  // are bound, or locality_t::any. Nodes without threads impose no binding.
+  std::size_t bound_node(const attributes& attrs) const noexcept
+  {
+    std::size_t node = attrs.locality_.node();
+    if (node < options_.nodes.size() && nodes_[node].threads_ > 0)
+      return node;
+    return execution::locality_t::any;
+  }
+
+  // Wraps a function whose submission carries a stop token, so that it is
+  // dropped if stop is requested before it is dequeued.
+  template<class Function>
+  struct cancellable
+  {
+    Function f_;
+    stop_token stop_;
+
+    void operator()()
+    {
+      if (!stop_.stop_requested())
+        f_();
+    }
+  };
+
+  template<class ProtoAllocator, class Function>
+  static func_base::pointer create_func(const ProtoAllocator& alloc, const attributes& attrs, Function f)
+  {
+    if (attrs.stop_.stop_possible())
+      return func<cancellable<Function>, ProtoAllocator>::create(cancellable<Function>{std::move(f), attrs.stop_}, alloc, attrs.locality_.node());
+    return func<Function, ProtoAllocator>::create(std::move(f), alloc, attrs.locality_.node());
+  }
+
+  template<class Blocking, class Continuation, class ProtoAllocator, class Function>
+  void execute(Blocking, Continuation, const ProtoAllocator& alloc, const attributes& attrs, Function f)
+  {
+    if (attrs.stop_.stop_requested())
+      return;
+
+    if (std::is_same<Blocking, execution::blocking_t::possibly_t>::value)
+    {
+      // Run immediately if already in the pool.
+      if (running_in_this_thread(bound_node(attrs)))
+      {
+        static_thread_pool::invoke(f);
+        return;
+      }
+    }
+
+    func_queue funcs;
+    funcs.push_back(create_func(alloc, attrs, std::move(f)));
+    this->enqueue(Continuation{}, attrs, funcs);
+  }
+
+  template<class Continuation, class ProtoAllocator, class Function>
+  void execute(execution::blocking_t::always_t, Continuation, const ProtoAllocator& alloc, const attributes& attrs, Function f)
+  {
+    if (attrs.stop_.stop_requested())
+      return;
+
+    // Run immediately if already in the pool.
+    if (running_in_this_thread(bound_node(attrs)))
+    {
+      static_thread_pool::invoke(f);
+      return;
+    }
+
+    // Otherwise, wrap the function with a guard that, when destroyed, will signal that the function is complete.
+    thread_pool_impl::completion_latch latch;
+    this->execute(execution::blocking.never, Continuation{}, alloc, attrs,
+        [f = std::move(f), g = thread_pool_impl::completion_latch::guard(&latch)]() mutable { f(); });
+    latch.wait();
+  }
+
+  // The function is moved into a queued node only if it cannot run at once.
+  template<class Blocking, class Continuation, class ProtoAllocator>
+  void execute_erased(Blocking, Continuation, const ProtoAllocator& alloc, const attributes& attrs,
+      const execution::executor_impl::erased_function& f)
+  {
+    if (attrs.stop_.stop_requested())
+      return;
+
+    if (std::is_same<Blocking, execution::blocking_t::possibly_t>::value)
+    {
+      // Run immediately if already in the pool.
+      if (running_in_this_thread(bound_node(attrs)))
+      {
+        static_thread_pool::invoke(f);
+        return;
+      }
+    }
+
+    func_queue funcs;
+    funcs.push_back(erased_func<ProtoAllocator>::create(f, alloc, attrs));
+    this->enqueue(Continuation{}, attrs, funcs);
+  }
+
+  // The caller's function outlives the wait, so it is run by reference.
+  template<class Continuation, class ProtoAllocator>
+  void execute_erased(execution::blocking_t::always_t, Continuation, const ProtoAllocator& alloc, const attributes& attrs,
+      const execution::executor_impl::erased_function& f)
+  {
+    this->execute(execution::blocking.always, Continuation{}, alloc, attrs, [&f]{ f(); });
+  }
+
+  template<class Clock, class Duration>
+  static std::chrono::steady_clock::time_point to_steady(const std::chrono::time_point<Clock, Duration>& t)
+  {
+    return std::chrono::steady_clock::now()
+      + std::chrono::ceil<std::chrono::steady_clock::duration>(t - Clock::now());
+  }
+
+  static std::chrono::steady_clock::time_point to_steady(const std::chrono::steady_clock::time_point& t)
+  {
+    return t;
+  }
+
+  template<class ProtoAllocator, class Function>
+  void execute_at(const ProtoAllocator& alloc, const attributes& attrs, std::chrono::steady_clock::time_point t, Function f)
+  {
+    if (attrs.stop_.stop_requested())
+      return;
+
+    func_base::pointer p = create_func(alloc, attrs, std::move(f));
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::size_t sequence = timer_sequence_++;
+    timers_.push_back(timer{t, sequence, std::move(p), attrs});
+    std::push_heap(timers_.begin(), timers_.end());
+
+    // A new earliest timer needs a parked thread to wait for it. If one is
+    // already waiting for a later timer, it must be woken to wait again.
+    if (timers_.front().sequence_ == sequence)
+    {
+      next_timer_.store(t.time_since_epoch().count(), std::memory_order_relaxed);
+      if (timer_waiter_)
+        condition_.notify_all();
+      else
+        condition_.notify_one();
+    }
+  }
+
+  // Whether the earliest timer has expired. May be called without mutex_.
+  bool timer_due() const noexcept
+  {
+    auto next = next_timer_.load(std::memory_order_relaxed);
+    return next != no_timer && next <= std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+
+  // Moves the functions of expired timers to the run queues. Requires mutex_,
+  // which is released while each function is enqueued.
+  void expire_timers(std::unique_lock<std::mutex>& lock)
+  {
+    auto now = std::chrono::steady_clock::now();
+    while (!timers_.empty() && timers_.front().time_ <= now)
+    {
+      std::pop_heap(timers_.begin(), timers_.end());
+      timer t(std::move(timers_.back()));
+      timers_.pop_back();
+      next_timer_.store(timers_.empty() ? no_timer : timers_.front().time_.time_since_epoch().count(),
+          std::memory_order_relaxed);
+
+      // Threads that stayed only for the timers may now exit.
+      if (timers_.empty() && work_ == 0)
+        condition_.notify_all();
+
+      lock.unlock();
+      func_queue funcs;
+      funcs.push_back(std::move(t.func_));
+      this->enqueue(execution::relationship.fork, t.attributes_, funcs);
+      lock.lock();
+    }
+  }
+
+  template<class Blocking, class Continuation, class ProtoAllocator, class Function>
+  auto twoway_execute(Blocking, Continuation, const ProtoAllocator& alloc, const attributes& attrs, Function f) -> future<decltype(f())>
+  {
+    packaged_task<decltype(f())()> task(std::allocator_arg, alloc, std::move(f));
+    future<decltype(f())> future = task.get_future();
+    this->execute(Blocking{}, Continuation{}, alloc, attrs, std::move(task));
+    return future;
+  }
+
+  template<class Function, class SharedFactory>
+  struct bulk_state
+  {
+    using partitioning = execution::bulk_chunk_size_t::partitioning;
+
+    Function f_;
+    decltype(std::declval<SharedFactory>()()) ss_;
+    std::size_t n_;
+    partitioning partitioning_;
+    std::size_t chunk_size_;
+    std::size_t descriptors_;
+    stop_token stop_;
+    std::atomic<std::size_t> next_{0};
+
+    bulk_state(Function f, std::size_t n, SharedFactory sf, partitioning p, std::size_t chunk_size, std::size_t descriptors, stop_token stop)
+      : f_(std::move(f)), ss_(sf()), n_(n), partitioning_(p), chunk_size_(chunk_size), descriptors_(descriptors), stop_(std::move(stop)) {}
+
+    // Runs the chunks assigned to, or claimed by, a descriptor. With static
+    // partitioning, position is the start of the descriptor's next chunk.
+    // Returns false if stopped early because yield() returned true. No further
+    // chunks are started once stop is requested.
+    template<class Yield>
+    bool operator()(std::size_t& position, Yield yield)
+    {
+      switch (partitioning_)
+      {
+      case partitioning::static_:
+        while (position < n_ && !stop_.stop_requested())
+        {
+          run(position, position + std::min(chunk_size_, n_ - position));
+          position += descriptors_ * chunk_size_;
+          if (position < n_ && yield())
+            return false;
+        }
+        break;
+      case partitioning::dynamic:
+        for (std::size_t begin; !stop_.stop_requested()
+            && (begin = next_.fetch_add(chunk_size_, std::memory_order_relaxed)) < n_;)
+        {
+          run(begin, begin + std::min(chunk_size_, n_ - begin));
+          if (yield())
+            return false;
+        }
+        break;
+      case partitioning::guided:
+        for (std::size_t begin = next_.load(std::memory_order_relaxed); begin < n_ && !stop_.stop_requested();)
+        {
+          std::size_t size = std::max(chunk_size_, (n_ - begin) / (2 * descriptors_));
+          std::size_t end = begin + std::min(size, n_ - begin);
+          if (next_.compare_exchange_weak(begin, end, std::memory_order_relaxed))
+          {
+            run(begin, end);
+            if (yield())
+              return false;
+            begin = next_.load(std::memory_order_relaxed);
+          }
+        }
+        break;
+      }
+      return true;
+    }
+
+    void run(std::size_t begin, std::size_t end)
+    {
+      for (std::size_t i = begin; i < end; ++i)
+        f_(i, ss_);
+    }
+  };
+
+  // Runs one descriptor of a bulk operation. When functions of higher priority
+  // are waiting and no thread is idle, it resubmits itself after the current
+  // chunk so that they may run first.
+  template<class State, class ProtoAllocator>
+  struct bulk_descriptor
+  {
+    static_thread_pool* pool_;
+    std::shared_ptr<State> state_;
+    std::size_t position_;
+    ProtoAllocator allocator_;
+    attributes attributes_;
+
+    void operator()()
+    {
+      execution::priority_t::level level = attributes_.priority_.value();
+      if (!(*state_)(position_, [this, level]{ return pool_->should_yield(level); }))
+      {
+        ProtoAllocator alloc(allocator_);
+        func_queue funcs;
+        std::size_t node = attributes_.locality_.node();
+        funcs.push_back(func<bulk_descriptor, ProtoAllocator>::create(std::move(*this), alloc, node));
+        pool_->enqueue(execution::relationship.fork, attributes_, funcs);
+      }
+    }
+  };
+
+  template<class Blocking, class Continuation, class ProtoAllocator, class Function, class SharedFactory>
+  void bulk_execute(Blocking, Continuation, const ProtoAllocator& alloc, const attributes& attrs, Function f, std::size_t n, SharedFactory sf)
+  {
+    using partitioning = execution::bulk_chunk_size_t::partitioning;
+
+    if (attrs.stop_.stop_requested())
+      return;
+
+    // Submit one function per thread, rather than one per index. Each of these
+    // runs chunks of indices from the shared state until none remain.
+    const execution::bulk_chunk_size_t& chunk = attrs.chunk_;
+    std::size_t node = bound_node(attrs);
+    std::size_t threads = node != execution::locality_t::any ? nodes_[node].threads_
+      : std::max<std::size_t>({attached_, thread_count_, 1});
+    std::size_t chunk_size = chunk.value();
+    if (chunk_size == 0)
+    {
+      if (chunk.partition() == partitioning::static_)
+        chunk_size = (n + threads - 1) / threads;
+      else if (chunk.partition() == partitioning::dynamic)
+        chunk_size = n / (threads * 8);
+      chunk_size = std::max<std::size_t>(chunk_size, 1);
+    }
+    std::size_t chunks = chunk.partition() == partitioning::guided ? n : (n + chunk_size - 1) / chunk_size;
+    std::size_t descriptors = std::min(chunks, threads);
+
+    typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<char> alloc2(alloc);
+    auto shared_state = std::allocate_shared<bulk_state<Function, SharedFactory>>(
+        alloc2, std::move(f), n, std::move(sf), chunk.partition(), chunk_size, descriptors, attrs.stop_);
+
+    if (descriptors == 0)
+      return;
+
+    using descriptor = bulk_descriptor<bulk_state<Function, SharedFactory>, ProtoAllocator>;
+    func_queue funcs;
+    for (std::size_t i = 0; i < descriptors; ++i)
+      funcs.push_back(func<descriptor, ProtoAllocator>::create(descriptor{this, shared_state, i * chunk_size, alloc, attrs}, alloc, node));
+
+    this->enqueue(Continuation{}, attrs, funcs);
+  }
+
+  template<class Continuation, class ProtoAllocator, class Function, class SharedFactory>
+  void bulk_execute(execution::blocking_t::always_t, Continuation, const ProtoAllocator& alloc, const attributes& attrs, Function f, std::size_t n, SharedFactory sf)
+  {
+    // Wrap the function with a guard that, when the shared state is destroyed, will signal that all indices are complete.
+    thread_pool_impl::completion_latch latch;
+    auto wrapped_f = [f = std::move(f), g = thread_pool_impl::completion_latch::guard(&latch)](std::size_t n, auto& s) mutable { f(n, s); };
+    this->bulk_execute(execution::blocking.never, Continuation{}, alloc, attrs, std::move(wrapped_f), n, std::move(sf));
+    latch.wait();
+  }
+
+  template<class Blocking, class Continuation, class ProtoAllocator, class Function, class ResultFactory, class SharedFactory>
+  auto bulk_twoway_execute(Blocking, Continuation, const ProtoAllocator& alloc, const attributes& attrs, Function f, std::size_t n, ResultFactory rf, SharedFactory sf)
+    -> typename std::enable_if<is_same<decltype(rf()), void>::value, future<void>>::type
+  {
+    // Wrap the shared state so that we can capture and return the result.
+    typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<char> alloc2(alloc);
+    auto shared_state = std::allocate_shared<
+        std::tuple<
+          std::atomic<std::size_t>, // Number of incomplete functions.
+          decltype(sf()), // Underlying shared state.
+          std::atomic<std::size_t>, // Number of exceptions raised.
+          std::exception_ptr, // First exception raised.
+          promise<void> // Promise to receive result
+        >>(alloc2, n, sf(), 0, nullptr, promise<void>(std::allocator_arg, alloc));
+    future<void> future = std::get<4>(*shared_state).get_future();
+
+    // Convert to a one way bulk operation.
+    this->bulk_execute(Blocking{}, Continuation{}, alloc, attrs,
+        [f = std::move(f)](auto i, auto& s) mutable
+        {
+          try
+          {
+            f(i, std::get<1>(*s));
+          }
+          catch (...)
+          {
+            if (std::get<2>(*s)++ == 0)
+              std::get<3>(*s) = std::current_exception();
+          }
+          if (--std::get<0>(*s) == 0)
+          {
+            if (std::get<3>(*s))
+              std::get<4>(*s).set_exception(std::get<3>(*s));
+            else
+              std::get<4>(*s).set_value();
+          }
+        }, n, [shared_state]{ return shared_state; });
+
+    return future;
+  }
+
+  template<class Blocking, class Continuation, class ProtoAllocator, class Function, class ResultFactory, class SharedFactory>
+  auto bulk_twoway_execute(Blocking, Continuation, const ProtoAllocator& alloc, const attributes& attrs, Function f, std::size_t n, ResultFactory rf, SharedFactory sf)
+    -> typename std::enable_if<!is_same<decltype(rf()), void>::value, future<decltype(rf())>>::type
+  {
+    // Wrap the shared state so that we can capture and return the result.
+    typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<char> alloc2(alloc);
+    auto shared_state = std::allocate_shared<
+        std::tuple<
+          std::atomic<std::size_t>, // Number of incomplete functions.
+          decltype(rf()), // Result.
+          decltype(sf()), // Underlying shared state.
+          std::atomic<std::size_t>, // Number of exceptions raised.
+          std::exception_ptr, // First exception raised.
+          promise<decltype(rf())> // Promise to receive result
+        >>(alloc2, n, rf(), sf(), 0, nullptr, promise<decltype(rf())>(std::allocator_arg, alloc));
     future<decltype(rf())> future = std::get<5>(*shared_state).get_future();
 
     // Convert to a one way bulk operation.
-    this->bulk_execute(Blocking{}, Continuation{}, alloc,
+    this->bulk_execute(Blocking{}, Continuation{}, alloc, attrs,
         [f = std::move(f)](auto i, auto& s) mutable
         {
           try
@@ -475,24 +1433,596 @@ private:
   }
 
   template<class Blocking, class Continuation, class ProtoAllocator, class Function, class ResultFactory, class SharedFactory>
-  auto bulk_twoway_execute(execution::blocking_t::always_t, Continuation, const ProtoAllocator& alloc, Function f, std::size_t n, ResultFactory rf, SharedFactory sf)
+  auto bulk_twoway_execute(execution::blocking_t::always_t, Continuation, const ProtoAllocator& alloc, const attributes& attrs, Function f, std::size_t n, ResultFactory rf, SharedFactory sf)
   {
-    auto future = this->bulk_twoway_execute(execution::blocking.never, Continuation{}, alloc, std::move(f), n, std::move(rf), std::move(sf));
+    auto future = this->bulk_twoway_execute(execution::blocking.never, Continuation{}, alloc, attrs, std::move(f), n, std::move(rf), std::move(sf));
     future.wait();
     return future;
   }
 
-  void work_up(execution::outstanding_work_t::tracked_t) noexcept
+  template<class Continuation>
+  void enqueue(Continuation, const attributes& attrs, func_queue& funcs)
   {
+    std::size_t n = funcs.size();
+
+    // Bound functions go to their node's queue, which only that node's threads
+    // poll. Parked threads share one condition, so wake them all rather than
+    // risk waking only threads of other nodes.
+    std::size_t node = bound_node(attrs);
+    if (node != execution::locality_t::any)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      nodes_[node].queue_.splice_back(funcs);
+      nodes_[node].size_.store(nodes_[node].queue_.size(), std::memory_order_relaxed);
+      if (idle_ != 0)
+        condition_.notify_all();
+      return;
+    }
+
+    // Functions with a high or low priority go to that level's queue.
+    if (attrs.priority_ != execution::priority_t{})
+    {
+      level_queue& level = attrs.priority_.value() == execution::priority_t::high ? high_ : low_;
+      std::unique_lock<std::mutex> lock(mutex_);
+      level.queue_.splice_back(funcs);
+      level.size_.store(level.queue_.size(), std::memory_order_relaxed);
+      notify(n);
+      return;
+    }
+
+    if (thread_private_state* private_state = thread_private_state::instance())
+    {
+      if (private_state->pool_ == this)
+      {
+        if (std::is_same<Continuation, execution::relationship_t::continuation_t>::value)
+        {
+          if (private_state->worker_ && options_.steal_continuations)
+          {
+            // Push to a queue that idle threads may steal from immediately.
+            push_continuations(*private_state->worker_, funcs);
+            private_state->published_continuations_ = true;
+            wake(n);
+            return;
+          }
+
+          // Push to thread-private queue.
+          private_state->queue_.splice_back(funcs);
+          return;
+        }
+
+        if (worker_state* worker = private_state->worker_)
+        {
+          // Push to this thread's own queue, where idle threads may steal it.
+          push_front(*worker, funcs);
+          wake(n);
+          return;
+        }
+      }
+    }
+
+    // Spread batches submitted from outside the pool across the worker queues.
+    if (options_.schedule == scheduling::work_stealing && n > 1)
+      distribute(funcs);
+
+    // Single functions bypass the mutex via the lock-free injection queue.
+    // Only the push is lock-free: wake() still takes the mutex when a thread
+    // is parked, as idle threads park on condition_ alongside the timers and
+    // the other queues. Batches, and single functions that find the
+    // injection queue full, go to queue_ instead. Threads drain the two
+    // queues independently, so functions from different submitters are not
+    // necessarily run in the order they were submitted.
+    if (n == 1)
+    {
+      // Unlink first, as another thread may run the function once pushed.
+      func_base::pointer func = funcs.pop_front();
+      if (injected_.try_push(func.get()))
+      {
+        func.release();
+        wake(1);
+        return;
+      }
+      funcs.push_back(std::move(func));
+    }
+
+    // Otherwise push to main queue.
     std::unique_lock<std::mutex> lock(mutex_);
-    ++work_;
+    queue_.splice_back(funcs);
+    queue_size_.store(queue_.size(), std::memory_order_relaxed);
+    notify(n);
   }
 
-  void work_down(execution::outstanding_work_t::tracked_t) noexcept
+  void flush_private_queue(thread_private_state& private_state)
+  {
+    if (private_state.queue_.empty() && !private_state.published_continuations_)
+      return;
+
+    // This thread will run the first of the spilled functions, so other
+    // threads are only needed for the remainder.
+    if (worker_state* worker = private_state.worker_)
+    {
+      std::size_t n;
+      {
+        std::unique_lock<std::mutex> lock(worker->mutex_);
+        worker->continuations_.splice_back(private_state.queue_);
+        n = worker->continuations_.size();
+        worker->queue_.splice_front(worker->continuations_);
+        worker->size_ = worker->queue_.size();
+      }
+      private_state.published_continuations_ = false;
+      if (n > 1)
+        wake(n - 1);
+    }
+    else
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      std::size_t n = private_state.queue_.size();
+      queue_.splice_back(private_state.queue_);
+      queue_size_.store(queue_.size(), std::memory_order_relaxed);
+      if (n > 1)
+        notify(n - 1);
+    }
+  }
+
+  template<class R>
+  void run_until(thread_private_state& private_state, const future<R>& f)
+  {
+    // Wakes the calling thread when the future becomes ready.
+    struct ready_signal : future_impl::continuation_base
+    {
+      explicit ready_signal(static_thread_pool* pool) : pool_(pool) {}
+
+      void run(bool) override
+      {
+        std::lock_guard<std::mutex> lock(pool_->mutex_);
+        ready_ = true;
+        pool_->condition_.notify_all();
+      }
+
+      void discard() noexcept override
+      {
+      }
+
+      static_thread_pool* pool_;
+      bool ready_ = false; // Guarded by mutex_.
+    } signal(this);
+
+    bool attached = future_impl::try_attach(f, &signal);
+
+    // Continuations deferred by the calling function may be what it waits for.
+    flush_private_queue(private_state);
+    while (!f.is_ready())
+    {
+      if (func_base::pointer func = poll_function(private_state))
+      {
+        func.release()->call();
+        flush_private_queue(private_state);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      ++idle_;
+      if (!signal.ready_ && !has_pending_work(private_state) && !timer_due())
+      {
+        if (!timers_.empty() && !timer_waiter_)
+        {
+          timer_waiter_ = true;
+          condition_.wait_until(lock, timers_.front().time_);
+          timer_waiter_ = false;
+          if (idle_ > 1)
+            condition_.notify_one();
+        }
+        else
+          condition_.wait(lock);
+      }
+      --idle_;
+    }
+
+    // The signal lives on this stack, so it must finish with the pool first.
+    if (attached)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [&]{ return signal.ready_; });
+    }
+  }
+
+  // Takes a function without blocking, or returns null.
+  func_base::pointer poll_function(thread_private_state& private_state)
+  {
+    if (timer_due())
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      expire_timers(lock);
+    }
+
+    node_state* node = bound_state(private_state);
+    bool normal_first = false;
+    if (func_base::pointer func = try_pop(private_state, node, normal_first))
+      return func;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (stopped_)
+        return nullptr;
+      if (func_base::pointer func = pop_locked(node, normal_first))
+        return func;
+    }
+
+    if (private_state.worker_)
+      return steal(*private_state.worker_);
+    return nullptr;
+  }
+
+  // Takes a function from the queues that may be polled without mutex_.
+  func_base::pointer try_pop(thread_private_state& private_state, node_state* node, bool& normal_first)
+  {
+    // Functions bound to this thread's node take precedence, as only the
+    // node's threads may run them.
+    if (!node || node->size_.load(std::memory_order_relaxed) == 0)
+    {
+      if (func_base::pointer func = pop_prioritised(private_state, normal_first))
+        return func;
+
+      if (private_state.worker_)
+        if (func_base::pointer func = pop_front(*private_state.worker_))
+          return func;
+
+      if (func_base* func = injected_.try_pop())
+        return func_base::pointer(func);
+    }
+
+    return nullptr;
+  }
+
+  // Takes a function from the queues guarded by mutex_. Requires mutex_.
+  func_base::pointer pop_locked(node_state* node, bool normal_first)
+  {
+    if (node && !node->queue_.empty())
+    {
+      func_base::pointer func = node->queue_.pop_front();
+      node->size_.store(node->queue_.size(), std::memory_order_relaxed);
+      return func;
+    }
+    if (!high_.queue_.empty() && !normal_first) return pop(high_);
+    if (!queue_.empty())
+    {
+      func_base::pointer func = queue_.pop_front();
+      queue_size_.store(queue_.size(), std::memory_order_relaxed);
+      return func;
+    }
+    if (func_base* func = injected_.try_pop()) return func_base::pointer(func);
+    if (!high_.queue_.empty()) return pop(high_);
+    if (!low_.queue_.empty()) return pop(low_);
+    return nullptr;
+  }
+
+  func_base::pointer next_function(thread_private_state& private_state)
+  {
+    if (timer_due())
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      expire_timers(lock);
+    }
+
+    node_state* node = bound_state(private_state);
+    bool normal_first = false;
+    if (func_base::pointer func = try_pop(private_state, node, normal_first))
+      return func;
+
+    for (std::unique_lock<std::mutex> lock(mutex_);;)
+    {
+      if (stopped_) return nullptr;
+      if (timer_due()) expire_timers(lock);
+      if (func_base::pointer func = pop_locked(node, normal_first))
+        return func;
+
+      if (private_state.worker_ || options_.idle.spin || options_.idle.yield)
+      {
+        lock.unlock();
+        if (private_state.worker_)
+          if (func_base::pointer func = steal(*private_state.worker_))
+            return func;
+        bool found = spin_for_work(private_state);
+        lock.lock();
+        if (found)
+          continue;
+      }
+
+      // The idle count must be published before re-checking the lock-free
+      // queues, so that a concurrent push either sees it or is seen by the check.
+      ++idle_;
+      if (!stopped_ && (work_ != 0 || !timers_.empty()) && !has_pending_work(private_state))
+      {
+        // One parked thread waits for the earliest timer on behalf of the rest.
+        if (!timers_.empty() && !timer_waiter_)
+        {
+          timer_waiter_ = true;
+          condition_.wait_until(lock, timers_.front().time_);
+          timer_waiter_ = false;
+          if (idle_ > 1)
+            condition_.notify_one();
+        }
+        else
+          condition_.wait(lock);
+      }
+      --idle_;
+
+      if (!stopped_ && work_ == 0 && timers_.empty() && !has_pending_work(private_state))
+        return nullptr;
+    }
+  }
+
+  // Takes a high priority function, or a low priority one that has been passed
+  // over too often. Sets normal_first instead if normal priority functions
+  // have themselves been passed over too often.
+  func_base::pointer pop_prioritised(const thread_private_state& private_state, bool& normal_first)
+  {
+    bool high = high_.size_.load(std::memory_order_relaxed) != 0;
+    bool low = low_.size_.load(std::memory_order_relaxed) != 0;
+    if (!high && !low)
+      return nullptr;
+
+    if (low && low_.skipped_.fetch_add(1, std::memory_order_relaxed) >= options_.starvation_limit)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!low_.queue_.empty())
+        return pop(low_);
+    }
+
+    if (!high)
+      return nullptr;
+
+    if (may_have_normal_work(private_state)
+        && normal_skipped_.fetch_add(1, std::memory_order_relaxed) >= options_.starvation_limit)
+    {
+      normal_skipped_.store(0, std::memory_order_relaxed);
+      normal_first = true;
+      return nullptr;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    return high_.queue_.empty() ? nullptr : pop(high_);
+  }
+
+  // Requires mutex_.
+  func_base::pointer pop(level_queue& level)
+  {
+    func_base::pointer func = level.queue_.pop_front();
+    level.size_.store(level.queue_.size(), std::memory_order_relaxed);
+    level.skipped_.store(0, std::memory_order_relaxed);
+    return func;
+  }
+
+  // Whether a bulk descriptor of the given priority should make way for queued
+  // functions of higher priority, because no thread is idle to run them.
+  bool should_yield(execution::priority_t::level level) const noexcept
+  {
+    if (level == execution::priority_t::high || idle_.load(std::memory_order_relaxed) != 0)
+      return false;
+    if (high_.size_.load(std::memory_order_relaxed) != 0)
+      return true;
+    return level == execution::priority_t::low
+      && (queue_size_.load(std::memory_order_relaxed) != 0 || !injected_.empty());
+  }
+
+  bool may_have_normal_work(const thread_private_state& private_state) const noexcept
+  {
+    return queue_size_.load(std::memory_order_relaxed) != 0 || !injected_.empty()
+      || (private_state.worker_ && private_state.worker_->size_.load(std::memory_order_relaxed) != 0);
+  }
+
+  // Polls for new work according to the idle policy, without taking the mutex.
+  // Returns true if work may be available.
+  bool spin_for_work(const thread_private_state& private_state) const noexcept
+  {
+    for (std::size_t i = 0; i < options_.idle.spin; ++i)
+    {
+      if (may_have_work(private_state))
+        return true;
+      static_thread_pool::pause();
+    }
+
+    for (std::size_t i = 0; i < options_.idle.yield; ++i)
+    {
+      if (may_have_work(private_state))
+        return true;
+      std::this_thread::yield();
+    }
+
+    return false;
+  }
+
+  bool may_have_work(const thread_private_state& private_state) const noexcept
+  {
+    const node_state* node = bound_state(private_state);
+    return queue_size_.load(std::memory_order_relaxed) != 0 || !injected_.empty()
+      || (node && node->size_.load(std::memory_order_relaxed) != 0)
+      || high_.size_.load(std::memory_order_relaxed) != 0
+      || low_.size_.load(std::memory_order_relaxed) != 0
+      || timer_due() || (private_state.worker_ && has_stealable_work());
+  }
+
+  node_state* bound_state(const thread_private_state& private_state) const noexcept
+  {
+    return private_state.node_ != execution::locality_t::any ? &nodes_[private_state.node_] : nullptr;
+  }
+
+  static void pause() noexcept
+  {
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    _mm_pause();
+#elif defined(__aarch64__) || (defined(__arm__) && __ARM_ARCH >= 7)
+    __asm__ __volatile__("yield");
+#endif
+  }
+
+  bool has_pending_work(const thread_private_state& private_state) const noexcept
+  {
+    const node_state* node = bound_state(private_state);
+    return !queue_.empty() || !injected_.empty() || (node && !node->queue_.empty())
+      || !high_.queue_.empty() || !low_.queue_.empty()
+      || (private_state.worker_ && has_stealable_work());
+  }
+
+  void push_front(worker_state& worker, func_queue& funcs)
+  {
+    std::unique_lock<std::mutex> lock(worker.mutex_);
+    worker.queue_.splice_front(funcs);
+    worker.size_ = worker.queue_.size() + worker.continuations_.size();
+  }
+
+  void push_continuations(worker_state& worker, func_queue& funcs)
+  {
+    std::unique_lock<std::mutex> lock(worker.mutex_);
+    worker.continuations_.splice_back(funcs);
+    worker.size_ = worker.queue_.size() + worker.continuations_.size();
+  }
+
+  func_base::pointer pop_front(worker_state& worker)
+  {
+    if (worker.size_.load(std::memory_order_relaxed) == 0)
+      return nullptr;
+    std::unique_lock<std::mutex> lock(worker.mutex_);
+    func_base::pointer func = worker.queue_.pop_front();
+    worker.size_ = worker.queue_.size() + worker.continuations_.size();
+    return func;
+  }
+
+  func_base::pointer steal(worker_state& thief)
+  {
+    // Try the thread's own queue first, as it may have been given work by distribute().
+    if (func_base::pointer func = pop_front(thief))
+      return func;
+
+    // Visit the other queues in turn, starting after the thief's own.
+    worker_state* head = workers_.load(std::memory_order_acquire);
+    for (worker_state* victim = thief.next_ ? thief.next_ : head; victim != &thief;
+        victim = victim->next_ ? victim->next_ : head)
+    {
+      if (victim->size_.load(std::memory_order_relaxed) == 0)
+        continue;
+      std::unique_lock<std::mutex> lock(victim->mutex_);
+      func_base::pointer func = victim->queue_.pop_back();
+      if (!func)
+        func = victim->continuations_.pop_front();
+      if (func)
+      {
+        victim->size_ = victim->queue_.size() + victim->continuations_.size();
+        return func;
+      }
+    }
+
+    return nullptr;
+  }
+
+  bool has_stealable_work() const noexcept
+  {
+    for (worker_state* worker = workers_.load(std::memory_order_acquire); worker; worker = worker->next_)
+      if (worker->size_ != 0)
+        return true;
+    return false;
+  }
+
+  void wake(std::size_t n)
+  {
+    // Only take the mutex if a thread is, or is about to be, parked.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idle_ != 0)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      notify(n);
+    }
+  }
+
+  // Wakes as many parked threads as there are new functions. Requires mutex_.
+  void notify(std::size_t n)
+  {
+    if (n >= idle_)
+      condition_.notify_all();
+    else
+      while (n-- > 0)
+        condition_.notify_one();
+  }
+
+  void distribute(func_queue& funcs)
   {
+    std::size_t workers = 0;
+    for (worker_state* worker = workers_.load(std::memory_order_acquire); worker; worker = worker->next_)
+      ++workers;
+
+    std::size_t chunk = (funcs.size() + workers - 1) / (workers ? workers : 1);
+    for (worker_state* worker = workers_.load(std::memory_order_acquire); worker && !funcs.empty(); worker = worker->next_)
+    {
+      std::unique_lock<std::mutex> lock(worker->mutex_);
+      if (worker->in_use_)
+      {
+        func_queue part;
+        funcs.split_front(chunk, part);
+        worker->queue_.splice_back(part);
+        worker->size_ = worker->queue_.size() + worker->continuations_.size();
+      }
+    }
+  }
+
+  worker_state* acquire_worker()
+  {
+    // Reuse a queue left behind by a thread that is no longer attached.
+    for (worker_state* worker = workers_.load(std::memory_order_acquire); worker; worker = worker->next_)
+    {
+      std::unique_lock<std::mutex> lock(worker->mutex_);
+      if (!worker->in_use_)
+      {
+        worker->in_use_ = true;
+        return worker;
+      }
+    }
+
+    // Queues are never removed until the pool is destroyed, so the list may
+    // be traversed without holding mutex_.
     std::unique_lock<std::mutex> lock(mutex_);
-    if (--work_ == 0)
+    worker_state* worker = new worker_state;
+    worker->in_use_ = true;
+    worker->next_ = workers_.load(std::memory_order_relaxed);
+    workers_.store(worker, std::memory_order_release);
+    return worker;
+  }
+
+  void release_worker(worker_state& worker)
+  {
+    func_queue funcs;
+    {
+      std::unique_lock<std::mutex> lock(worker.mutex_);
+      worker.in_use_ = false;
+      funcs.splice_back(worker.queue_);
+      funcs.splice_back(worker.continuations_);
+      worker.size_ = 0;
+    }
+
+    // Hand any remaining functions over to the threads that are still attached.
+    if (!funcs.empty())
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queue_.splice_back(funcs);
+      queue_size_.store(queue_.size(), std::memory_order_relaxed);
+      condition_.notify_all();
+    }
+  }
+
+  void work_up(execution::outstanding_work_t::tracked_t) noexcept
+  {
+    work_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Only the last decrement takes the mutex, so that threads checking work_
+  // under it cannot miss the notification.
+  void work_down(execution::outstanding_work_t::tracked_t) noexcept
+  {
+    if (work_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
       condition_.notify_all();
+    }
   }
 
   void work_up(execution::outstanding_work_t::untracked_t) noexcept {}
@@ -501,10 +2031,26 @@ private:
   std::mutex mutex_;
   std::condition_variable condition_;
   std::list<std::thread> threads_;
-  func_base::pointer head_;
-  func_base::pointer* tail_{&head_};
+  func_queue queue_;
+  std::atomic<std::size_t> queue_size_{0}; // Lets idle threads poll queue_ without the mutex.
+  injection_queue injected_;
+  const options options_;
+  const std::size_t thread_count_;
+  std::unique_ptr<node_state[]> nodes_;
+  level_queue high_;
+  level_queue low_;
+  std::atomic<std::size_t> normal_skipped_{0}; // Times passed over for high_ since last run.
+  std::vector<timer> timers_; // Heap ordered by expiry.
+  std::size_t timer_sequence_{0};
+  static constexpr std::chrono::steady_clock::rep no_timer = std::numeric_limits<std::chrono::steady_clock::rep>::max();
+  std::atomic<std::chrono::steady_clock::rep> next_timer_{no_timer}; // Expiry of timers_.front(), for polling.
+  bool timer_waiter_{false};
+  std::atomic<worker_state*> workers_{nullptr};
+  std::atomic<std::size_t> idle_{0};
+  std::atomic<std::size_t> attached_{0};
   bool stopped_{false};
-  std::size_t work_{1};
+  bool waited_{false}; // Whether wait() has released the pool's own work.
+  std::atomic<std::size_t> work_{1}; // Outstanding work, including the pool's own until wait().
 };
 
 } // inline namespace executors_v1
@@ -0,0 +1,117 @@
+#ifndef STD_EXPERIMENTAL_BITS_STOP_TOKEN_H
+#define STD_EXPERIMENTAL_BITS_STOP_TOKEN_H
+
+#include <atomic>
+#include <memory>
+
+namespace std {
+namespace experimental {
+inline namespace executors_v1 {
+
+// Observes whether cancellation has been requested through a stop_source.
+class stop_token
+{
+public:
+  stop_token() noexcept = default;
+
+  bool stop_requested() const noexcept
+  {
+    return state_ && state_->load(std::memory_order_acquire);
+  }
+
+  // False for a default constructed token, which can never be stopped.
+  bool stop_possible() const noexcept
+  {
+    return state_ != nullptr;
+  }
+
+  friend bool operator==(const stop_token& a, const stop_token& b) noexcept
+  {
+    return a.state_ == b.state_;
+  }
+
+  friend bool operator!=(const stop_token& a, const stop_token& b) noexcept
+  {
+    return a.state_ != b.state_;
+  }
+
+private:
+  friend class stop_source;
+  explicit stop_token(std::shared_ptr<std::atomic<bool>> state) noexcept : state_(std::move(state)) {}
+
+  std::shared_ptr<std::atomic<bool>> state_;
+};
+
+// Requests cancellation of the work associated with its tokens.
+class stop_source
+{
+public:
+  stop_source() : state_(std::make_shared<std::atomic<bool>>(false)) {}
+
+  stop_token get_token() const noexcept
+  {
+    return stop_token(state_);
+  }
+
+  bool stop_requested() const noexcept
+  {
+    return state_->load(std::memory_order_acquire);
+  }
+
+  // Returns true if this call made the request.
+  bool request_stop() noexcept
+  {
+    return !state_->exchange(true, std::memory_order_acq_rel);
+  }
+
+private:
+  std::shared_ptr<std::atomic<bool>> state_;
+};
+
+namespace execution {
+
+struct cancellation_t
+{
+  static constexpr bool is_requirable = true;
+  static constexpr bool is_preferable = true;
+
+  using polymorphic_query_result_type = cancellation_t;
+
+  template<class Executor, class Type = decltype(Executor::query(*static_cast<cancellation_t*>(0)))>
+    static constexpr Type static_query_v = Executor::query(cancellation_t());
+
+  // Functions submitted through the executor are dropped without running if
+  // stop is requested before they start, and bulk operations stop handing out
+  // indices. Functions that have started run to completion.
+  cancellation_t() = default;
+  explicit cancellation_t(stop_token token) noexcept : token_(std::move(token)) {}
+
+  cancellation_t operator()(stop_token token) const noexcept
+  {
+    return cancellation_t(std::move(token));
+  }
+
+  const stop_token& value() const noexcept { return token_; }
+
+  friend bool operator==(const cancellation_t& a, const cancellation_t& b) noexcept
+  {
+    return a.token_ == b.token_;
+  }
+
+  friend bool operator!=(const cancellation_t& a, const cancellation_t& b) noexcept
+  {
+    return !(a == b);
+  }
+
+private:
+  stop_token token_;
+};
+
+inline const cancellation_t cancellation{};
+
+} // namespace execution
+} // inline namespace executors_v1
+} // namespace experimental
+} // namespace std
+
+#endif // STD_EXPERIMENTAL_BITS_STOP_TOKEN_H
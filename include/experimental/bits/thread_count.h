@@ -0,0 +1,40 @@
+#ifndef STD_EXPERIMENTAL_BITS_THREAD_COUNT_H
+#define STD_EXPERIMENTAL_BITS_THREAD_COUNT_H
+
+#include <cstddef>
+
+namespace std {
+namespace experimental {
+inline namespace executors_v1 {
+namespace execution {
+namespace thread_count_impl {
+
+template<class Derived>
+struct property_base
+{
+  static constexpr bool is_requirable = false;
+  static constexpr bool is_preferable = false;
+
+  using polymorphic_query_result_type = std::size_t;
+
+  template<class Executor, class Type = decltype(Executor::query(*static_cast<Derived*>(0)))>
+    static constexpr Type static_query_v = Executor::query(Derived());
+};
+
+} // namespace thread_count_impl
+
+// Number of threads currently running in the executor's context.
+struct thread_count_t : thread_count_impl::property_base<thread_count_t> {};
+
+// Number of those threads that are currently waiting for work.
+struct idle_thread_count_t : thread_count_impl::property_base<idle_thread_count_t> {};
+
+constexpr thread_count_t thread_count;
+constexpr idle_thread_count_t idle_thread_count;
+
+} // namespace execution
+} // inline namespace executors_v1
+} // namespace experimental
+} // namespace std
+
+#endif // STD_EXPERIMENTAL_BITS_THREAD_COUNT_H
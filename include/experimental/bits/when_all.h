@@ -0,0 +1,250 @@
+#ifndef STD_EXPERIMENTAL_BITS_WHEN_ALL_H
+#define STD_EXPERIMENTAL_BITS_WHEN_ALL_H
+
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace std {
+namespace experimental {
+inline namespace executors_v1 {
+
+template<class Sequence>
+struct when_any_result
+{
+  std::size_t index;
+  Sequence futures;
+};
+
+namespace future_impl {
+
+template<class T> struct is_future : std::false_type {};
+template<class R> struct is_future<future<R>> : std::true_type {};
+
+template<class... T> struct all_futures : std::conjunction<is_future<typename std::decay<T>::type>...> {};
+
+// Block shared by the inputs of when_all, or of when_any if Any is true. Each
+// input holds a reference through its continuation, as does the delivery of
+// the result, so the block lives until all inputs are ready. start() holds
+// back delivery until every input is attached, as delivery moves the inputs.
+template<class Sequence, class Executor, bool Any>
+class when_state
+{
+public:
+  using result_type = typename std::conditional<Any, when_any_result<Sequence>, Sequence>::type;
+
+  when_state(Sequence futures, std::size_t n, Executor ex)
+    : futures_(std::move(futures)), executor_(std::move(ex)), refs_(n + 2),
+      remaining_(Any ? (n ? 2 : 1) : n + 1) {}
+
+  when_state(const when_state&) = delete;
+  when_state& operator=(const when_state&) = delete;
+
+  void add_ref() noexcept
+  {
+    refs_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void release() noexcept
+  {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete this;
+  }
+
+  // Attaches to every input, then drops the creator's reference.
+  future<result_type> start()
+  {
+    future<result_type> result = promise_.get_future();
+    attach_all(futures_);
+    arrive();
+    release();
+    return result;
+  }
+
+private:
+  template<class R>
+  void attach_all(std::vector<future<R>>& futures)
+  {
+    for (std::size_t i = 0, n = futures.size(); i < n; ++i)
+      attach(futures[i], i);
+  }
+
+  template<class... R>
+  void attach_all(std::tuple<future<R>...>& futures)
+  {
+    attach_all(futures, std::index_sequence_for<R...>{});
+  }
+
+  template<class Tuple, std::size_t... I>
+  void attach_all(Tuple& futures, std::index_sequence<I...>)
+  {
+    (attach(std::get<I>(futures), I), ...);
+  }
+
+  template<class R>
+  void attach(future<R>& f, std::size_t index)
+  {
+    if (!f.state_)
+    {
+      ready(index);
+      release();
+      return;
+    }
+
+    state_ptr<shared_state<R>> state(f.state_);
+    state->attach([self = state_ptr<when_state>(this), index](bool)
+        {
+          self->ready(index);
+        });
+  }
+
+  // For when_any, only the first input to become ready counts.
+  void ready(std::size_t index)
+  {
+    if (!Any)
+      arrive();
+    else if (!delivered_.exchange(true, std::memory_order_acq_rel))
+    {
+      index_ = index;
+      arrive();
+    }
+  }
+
+  void arrive()
+  {
+    if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      deliver();
+  }
+
+  // If the executor drops the function, the promise is broken when the block
+  // is destroyed.
+  void deliver()
+  {
+    executor_.execute([self = state_ptr<when_state>(this), index = index_]() mutable
+        {
+          self->complete(index, std::integral_constant<bool, Any>{});
+        });
+  }
+
+  void complete(std::size_t index, std::true_type)
+  {
+    promise_.set_value(result_type{index, std::move(futures_)});
+  }
+
+  void complete(std::size_t, std::false_type)
+  {
+    promise_.set_value(std::move(futures_));
+  }
+
+  Sequence futures_;
+  promise<result_type> promise_;
+  Executor executor_;
+  std::atomic<std::size_t> refs_;
+  std::atomic<std::size_t> remaining_;
+  std::atomic<bool> delivered_{false};
+  std::size_t index_ = std::size_t(-1);
+};
+
+template<bool Any, class Executor, class Sequence>
+inline auto when(const Executor& ex, Sequence futures, std::size_t n)
+{
+  using executor_type = decltype(execution::require(ex, execution::oneway));
+  return (new when_state<Sequence, executor_type, Any>(
+        std::move(futures), n, execution::require(ex, execution::oneway)))->start();
+}
+
+template<class InputIterator>
+inline auto to_vector(InputIterator first, InputIterator last)
+{
+  return std::vector<typename std::iterator_traits<InputIterator>::value_type>(
+      std::make_move_iterator(first), std::make_move_iterator(last));
+}
+
+} // namespace future_impl
+
+// Returns a future that becomes ready, holding the input futures, once all of
+// them are ready. The result is delivered through the executor, if one is
+// given, or else on the thread that makes the last input ready.
+
+template<class Executor, class InputIterator,
+  class = typename std::enable_if<!future_impl::is_future<Executor>::value
+    && !future_impl::is_future<InputIterator>::value>::type>
+inline auto when_all(const Executor& ex, InputIterator first, InputIterator last)
+{
+  auto futures = future_impl::to_vector(first, last);
+  std::size_t n = futures.size();
+  return future_impl::when<false>(ex, std::move(futures), n);
+}
+
+template<class InputIterator,
+  class = typename std::enable_if<!future_impl::is_future<InputIterator>::value>::type>
+inline auto when_all(InputIterator first, InputIterator last)
+{
+  return when_all(future_impl::default_executor(), first, last);
+}
+
+template<class Executor, class... Futures,
+  class = typename std::enable_if<!future_impl::is_future<typename std::decay<Executor>::type>::value
+    && future_impl::all_futures<Futures...>::value>::type>
+inline auto when_all(const Executor& ex, Futures&&... futures)
+  -> future<std::tuple<typename std::decay<Futures>::type...>>
+{
+  return future_impl::when<false>(ex,
+      std::tuple<typename std::decay<Futures>::type...>(std::forward<Futures>(futures)...), sizeof...(Futures));
+}
+
+template<class... Futures,
+  class = typename std::enable_if<future_impl::all_futures<Futures...>::value>::type>
+inline auto when_all(Futures&&... futures)
+  -> future<std::tuple<typename std::decay<Futures>::type...>>
+{
+  return when_all(future_impl::default_executor(), std::forward<Futures>(futures)...);
+}
+
+// Returns a future that becomes ready, holding the input futures and the
+// index of the first to become ready, once any of them is ready.
+
+template<class Executor, class InputIterator,
+  class = typename std::enable_if<!future_impl::is_future<Executor>::value
+    && !future_impl::is_future<InputIterator>::value>::type>
+inline auto when_any(const Executor& ex, InputIterator first, InputIterator last)
+{
+  auto futures = future_impl::to_vector(first, last);
+  std::size_t n = futures.size();
+  return future_impl::when<true>(ex, std::move(futures), n);
+}
+
+template<class InputIterator,
+  class = typename std::enable_if<!future_impl::is_future<InputIterator>::value>::type>
+inline auto when_any(InputIterator first, InputIterator last)
+{
+  return when_any(future_impl::default_executor(), first, last);
+}
+
+template<class Executor, class... Futures,
+  class = typename std::enable_if<!future_impl::is_future<typename std::decay<Executor>::type>::value
+    && future_impl::all_futures<Futures...>::value>::type>
+inline auto when_any(const Executor& ex, Futures&&... futures)
+  -> future<when_any_result<std::tuple<typename std::decay<Futures>::type...>>>
+{
+  return future_impl::when<true>(ex,
+      std::tuple<typename std::decay<Futures>::type...>(std::forward<Futures>(futures)...), sizeof...(Futures));
+}
+
+template<class... Futures,
+  class = typename std::enable_if<future_impl::all_futures<Futures...>::value>::type>
+inline auto when_any(Futures&&... futures)
+  -> future<when_any_result<std::tuple<typename std::decay<Futures>::type...>>>
+{
+  return when_any(future_impl::default_executor(), std::forward<Futures>(futures)...);
+}
+
+} // inline namespace executors_v1
+} // namespace experimental
+} // namespace std
+
+#endif // STD_EXPERIMENTAL_BITS_WHEN_ALL_H
@@ -0,0 +1,160 @@
+#include <experimental/future>
+#include <experimental/thread_pool>
+#include <cassert>
+#include <thread>
+
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <exception>
+
+namespace execution = std::experimental::execution;
+using std::experimental::static_thread_pool;
+template<class R> using promise = std::experimental::executors_v1::promise<R>;
+template<class R> using future = std::experimental::executors_v1::future<R>;
+
+future<int> add_one(future<int> f)
+{
+  co_return co_await std::move(f) + 1;
+}
+
+void co_await_future_test()
+{
+  promise<int> p;
+  future<int> f = add_one(p.get_future());
+  p.set_value(1);
+  assert(f.get() == 2);
+
+  promise<int> q;
+  q.set_value(2);
+  assert(add_one(q.get_future()).get() == 3);
+}
+
+template<class Executor>
+future<std::thread::id> scheduled_on(Executor ex)
+{
+  co_await std::experimental::schedule(ex);
+  co_return std::this_thread::get_id();
+}
+
+void schedule_test()
+{
+  static_thread_pool pool(1);
+  assert(scheduled_on(pool.executor()).get() != std::this_thread::get_id());
+}
+
+template<class Executor>
+future<std::thread::id> resumed_on(Executor ex, future<int> f)
+{
+  co_await std::experimental::resume_on(ex, std::move(f));
+  co_return std::this_thread::get_id();
+}
+
+void resume_on_test()
+{
+  static_thread_pool pool(1);
+  promise<int> p;
+  future<std::thread::id> f = resumed_on(execution::require(pool.executor(), execution::blocking.never), p.get_future());
+  p.set_value(1);
+  assert(f.get() != std::this_thread::get_id());
+}
+
+// A coroutine whose frame is destroyed by its owner.
+struct owned_coroutine
+{
+  struct promise_type
+  {
+    owned_coroutine get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+owned_coroutine await_forever(future<int> f, bool& resumed)
+{
+  co_await std::move(f);
+  resumed = true;
+}
+
+void destroyed_while_suspended_test()
+{
+  promise<int> p;
+  future<int> f = p.get_future();
+  std::experimental::executors_v1::shared_future<int> s = f.share();
+  int observed = 0;
+  auto then = s.then([&observed](std::experimental::executors_v1::shared_future<int> r) { observed = r.get(); });
+
+  bool resumed = false;
+  promise<int> q;
+  owned_coroutine c = await_forever(q.get_future(), resumed);
+  c.handle_.destroy();
+  q.set_value(1);
+  assert(!resumed);
+
+  p.set_value(2);
+  then.get();
+  assert(observed == 2);
+}
+
+// Counts the allocations made through it.
+template<class T>
+struct counting_allocator
+{
+  using value_type = T;
+  std::size_t* count_;
+
+  explicit counting_allocator(std::size_t* count) noexcept : count_(count) {}
+  template<class U> counting_allocator(const counting_allocator<U>& a) noexcept : count_(a.count_) {}
+
+  T* allocate(std::size_t n) { ++*count_; return std::allocator<T>().allocate(n); }
+  void deallocate(T* p, std::size_t n) noexcept { std::allocator<T>().deallocate(p, n); }
+
+  friend bool operator==(const counting_allocator& a, const counting_allocator& b) noexcept { return a.count_ == b.count_; }
+  friend bool operator!=(const counting_allocator& a, const counting_allocator& b) noexcept { return a.count_ != b.count_; }
+};
+
+template<class Executor>
+future<int> allocated_by(Executor, int i)
+{
+  co_return i;
+}
+
+template<class Executor>
+std::experimental::task<int> task_allocated_by(Executor, int i)
+{
+  co_return i;
+}
+
+// The frame of a coroutine whose first parameter is an executor comes from
+// the executor's allocator.
+void frame_allocator_test()
+{
+  static_thread_pool pool(1);
+  std::size_t count = 0;
+  auto ex = execution::require(pool.executor(), execution::allocator(counting_allocator<void>(&count)));
+  assert(allocated_by(ex, 1).get() == 1);
+  assert(count == 1);
+  assert(std::experimental::spawn(task_allocated_by(ex, 2)).get() == 2);
+  assert(count == 2);
+}
+
+int main()
+{
+  co_await_future_test();
+  schedule_test();
+  resume_on_test();
+  destroyed_while_suspended_test();
+  frame_allocator_test();
+}
+
+#else // defined(__cpp_impl_coroutine)
+
+int main()
+{
+}
+
+#endif // defined(__cpp_impl_coroutine)
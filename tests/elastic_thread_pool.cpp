@@ -0,0 +1,168 @@
+#include <experimental/thread_pool>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace execution = std::experimental::execution;
+using std::experimental::elastic_thread_pool;
+
+// The elastic pool shares the static pool's executor interface. Only what it
+// adds is compiled here.
+template<class Executor>
+void elastic_thread_pool_executor_compile_test(Executor ex1)
+{
+  const Executor& cex1 = ex1;
+
+  static_assert(execution::is_oneway_executor_v<Executor>, "is_oneway_executor must evaluate true");
+  static_assert(execution::is_bulk_oneway_executor_v<Executor>, "is_bulk_oneway_executor must evaluate true");
+
+  elastic_thread_pool& pool = execution::query(cex1, execution::context);
+  (void)pool;
+
+  std::size_t threads = execution::query(cex1, execution::thread_count);
+  (void)threads;
+
+  std::size_t idle_threads = execution::query(cex1, execution::idle_thread_count);
+  (void)idle_threads;
+
+  execution::bulk_chunk_size_t chunk = execution::query(cex1, execution::bulk_chunk_size);
+  (void)chunk;
+
+  cex1.execute([]{});
+  cex1.bulk_execute([](std::size_t, int&){}, 1, []{ return 42; });
+  execution::require(cex1, execution::twoway).twoway_execute([]{ return 42; });
+  execution::require(cex1, execution::bulk_chunk_size(64)).bulk_execute([](std::size_t, int&){}, 1, []{ return 42; });
+}
+
+void elastic_thread_pool_compile_test()
+{
+  using executor_type = elastic_thread_pool::executor_type;
+
+  elastic_thread_pool pool1(0, 0);
+  elastic_thread_pool::options options2;
+  options2.max_threads = 0;
+  options2.idle_timeout = std::chrono::milliseconds(100);
+  elastic_thread_pool pool2(options2);
+
+  pool1.attach();
+
+  pool1.stop();
+
+  pool1.wait();
+
+  executor_type ex1(pool1.executor());
+
+  elastic_thread_pool_executor_compile_test(ex1);
+  elastic_thread_pool_executor_compile_test(execution::require(ex1, execution::blocking.never));
+  elastic_thread_pool_executor_compile_test(execution::require(ex1, execution::blocking.always));
+  elastic_thread_pool_executor_compile_test(execution::require(ex1, execution::outstanding_work.tracked));
+}
+
+// Functions that block until all of them are running, which requires a
+// thread each.
+struct rendezvous
+{
+  std::size_t expected;
+  std::atomic<std::size_t> arrived{0};
+  std::atomic<bool> released{false};
+
+  explicit rendezvous(std::size_t n) : expected(n) {}
+
+  template<class Executor>
+  void submit(const Executor& ex)
+  {
+    for (std::size_t i = 0; i < expected; ++i)
+      ex.execute([this]{ ++arrived; while (!released) std::this_thread::yield(); });
+  }
+
+  // Waits up to a second for the given number of functions to be running.
+  bool await(std::size_t n)
+  {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (arrived < n && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    return arrived >= n;
+  }
+};
+
+template<class Predicate>
+bool eventually(Predicate p)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (!p() && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  return p();
+}
+
+// Threads are added while every thread is blocked, and those above the
+// minimum retire once idle for the timeout.
+void elastic_thread_pool_growth_test()
+{
+  elastic_thread_pool::options options;
+  options.min_threads = 1;
+  options.max_threads = 8;
+  options.idle_timeout = std::chrono::milliseconds(20);
+  elastic_thread_pool pool(options);
+  auto ex = execution::require(pool.executor(), execution::blocking.never);
+  assert(execution::query(ex, execution::thread_count) == 1);
+
+  rendezvous r(4);
+  r.submit(ex);
+  assert(r.await(4));
+  assert(execution::query(ex, execution::thread_count) >= 4);
+  r.released = true;
+
+  assert(eventually([&]{ return execution::query(ex, execution::thread_count) == 1; }));
+  assert(eventually([&]{ return execution::query(ex, execution::idle_thread_count) == 1; }));
+}
+
+// Threads are not added beyond the maximum, even while all are blocked.
+void elastic_thread_pool_max_threads_test()
+{
+  elastic_thread_pool pool(0, 2);
+  auto ex = execution::require(pool.executor(), execution::blocking.never);
+  rendezvous r(4);
+  r.submit(ex);
+  assert(r.await(2));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  assert(r.arrived == 2);
+  assert(execution::query(ex, execution::thread_count) == 2);
+  r.released = true;
+  pool.wait();
+  assert(r.arrived == 4);
+}
+
+// Every index runs exactly once, whatever the chunk size and partitioning.
+void elastic_thread_pool_bulk_chunk_test()
+{
+  using partitioning = execution::bulk_chunk_size_t::partitioning;
+
+  elastic_thread_pool pool(2, 4);
+  const execution::bulk_chunk_size_t chunks[] =
+  {
+    execution::bulk_chunk_size,
+    execution::bulk_chunk_size(1),
+    execution::bulk_chunk_size(7, partitioning::static_),
+    execution::bulk_chunk_size(0, partitioning::static_),
+    execution::bulk_chunk_size(0, partitioning::dynamic),
+    execution::bulk_chunk_size(3, partitioning::guided),
+  };
+  for (auto& chunk : chunks)
+  {
+    std::vector<std::atomic<int>> calls(1000);
+    auto ex = execution::require(pool.executor(), execution::blocking.always, chunk);
+    assert(execution::query(ex, execution::bulk_chunk_size) == chunk);
+    ex.bulk_execute([&calls](std::size_t i, int&){ ++calls[i]; }, calls.size(), []{ return 0; });
+    for (auto& c : calls)
+      assert(c == 1);
+  }
+}
+
+int main()
+{
+  elastic_thread_pool_growth_test();
+  elastic_thread_pool_max_threads_test();
+  elastic_thread_pool_bulk_chunk_test();
+}
@@ -1,8 +1,12 @@
 #include <experimental/execution>
 #include <experimental/thread_pool>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
 
 namespace execution = std::experimental::execution;
 using std::experimental::static_thread_pool;
+using std::experimental::elastic_thread_pool;
 using std::experimental::executors_v1::future;
 
 using executor = execution::executor<
@@ -81,6 +85,13 @@ void executor_compile_test()
   ex1 = execution::prefer(cex1, execution::bulk_guarantee.unsequenced);
   ex1 = execution::prefer(cex1, execution::mapping.new_thread);
 
+  execution::blocking_t bl1 = execution::query(cex1, execution::blocking.never);
+  (void)bl1;
+
+  execution::executor<execution::mapping_t::thread_t, execution::oneway_t> ex10(cex1);
+  execution::mapping_t m1 = execution::query(ex10, execution::mapping.thread);
+  (void)m1;
+
   cex1.execute([]{});
 
   std::experimental::executors_v1::future<int> f1 = cex1.twoway_execute([]{ return 42; });
@@ -94,13 +105,15 @@ void executor_compile_test()
   bool b1 = static_cast<bool>(ex1);
   (void)b1;
 
+#if defined(__cpp_rtti) || defined(_CPPRTTI)
   const std::type_info& target_type = cex1.target_type();
   (void)target_type;
+#endif
 
   static_thread_pool::executor_type* ex9 = ex1.target<static_thread_pool::executor_type>();
   (void)ex9;
 
-  const static_thread_pool::executor_type* cex6 = ex1.target<static_thread_pool::executor_type>();
+  const static_thread_pool::executor_type* cex6 = cex1.target<static_thread_pool::executor_type>();
   (void)cex6;
 
   bool b2 = (cex1 == cex2);
@@ -124,6 +137,40 @@ void executor_compile_test()
   swap(ex1, ex2);
 }
 
+// Functions aligned more strictly than the pools' node allocations.
+template<class Pool>
+void over_aligned_function_test(Pool& pool)
+{
+  struct alignas(64) over_aligned { char data[64]; };
+
+  execution::executor<execution::oneway_t, execution::single_t, execution::blocking_t::never_t> ex1(
+      execution::require(pool.executor(), execution::blocking.never));
+
+  // Hold the pool back so that the queued functions are all allocated at once.
+  std::atomic<bool> go{false};
+  ex1.execute([&go]{ while (!go) std::this_thread::yield(); });
+
+  std::atomic<int> misaligned{0};
+  for (int i = 0; i < 100; ++i)
+  {
+    ex1.execute([&misaligned, d = over_aligned{}]
+        {
+          // Read through a volatile so the compiler cannot assume alignment.
+          const void* volatile p = &d;
+          if (reinterpret_cast<std::uintptr_t>(p) % alignof(over_aligned) != 0)
+            ++misaligned;
+        });
+  }
+  go = true;
+  pool.wait();
+  assert(misaligned == 0);
+}
+
 int main()
 {
+  static_thread_pool pool1(1);
+  over_aligned_function_test(pool1);
+
+  elastic_thread_pool pool2(1, 2);
+  over_aligned_function_test(pool2);
 }
@@ -1,8 +1,10 @@
 #include <experimental/future>
+#include <cassert>
 
 namespace execution = std::experimental::execution;
 template<class R> using promise = std::experimental::executors_v1::promise<R>;
 template<class R> using future = std::experimental::executors_v1::future<R>;
+template<class R> using shared_future = std::experimental::executors_v1::shared_future<R>;
 template<class R> using packaged_task = std::experimental::executors_v1::packaged_task<R>;
 
 struct move_only
@@ -69,6 +71,9 @@ void future_compile_test()
   bool valid = f1.valid();
   (void)valid;
 
+  bool ready = f1.is_ready();
+  (void)ready;
+
   f1.wait();
 
   f1.wait_for(std::chrono::seconds(1));
@@ -99,6 +104,9 @@ void future_void_compile_test()
   bool valid = f1.valid();
   (void)valid;
 
+  bool ready = f1.is_ready();
+  (void)ready;
+
   f1.wait();
 
   f1.wait_for(std::chrono::seconds(1));
@@ -110,6 +118,193 @@ void future_void_compile_test()
   future<void> f8 = f1.then([](future<void> f){ return f; });
 }
 
+void shared_future_compile_test()
+{
+  promise<move_only> p1;
+
+  shared_future<move_only> f1(p1.get_future());
+  shared_future<move_only> f2 = p1.get_future().share();
+  shared_future<move_only> f3(f2);
+  shared_future<move_only> f4 = std::move(f3);
+
+  f1 = f4;
+
+  const move_only& r1 = f1.get();
+  (void)r1;
+
+  bool valid = f1.valid();
+  (void)valid;
+
+  bool ready = f1.is_ready();
+  (void)ready;
+
+  f1.wait();
+
+  f1.wait_for(std::chrono::seconds(1));
+
+  f1.wait_until(std::chrono::system_clock::now() + std::chrono::seconds(1));
+
+  future<void> f5 = f1.then([](shared_future<move_only>){});
+  future<int> f6 = f1.then([](shared_future<move_only>){ return 42; });
+  future<move_only> f7 = f1.then([](shared_future<move_only>){ return future<move_only>(); });
+}
+
+void shared_future_void_compile_test()
+{
+  promise<void> p1;
+
+  shared_future<void> f1(p1.get_future());
+  shared_future<void> f2 = f1;
+
+  f1.get();
+
+  future<void> f3 = f1.then([](shared_future<void>){});
+  future<int> f4 = f2.then([](shared_future<void>){ return 42; });
+}
+
+void packaged_task_compile_test()
+{
+  packaged_task<move_only(int)> t1([](int){ return move_only(); });
+  packaged_task<move_only(int)> t2(std::allocator_arg, std::allocator<char>(), [](int){ return move_only(); });
+  packaged_task<move_only(int)> t3(std::move(t1));
+  packaged_task<move_only(int)> t4 = std::move(t3);
+
+  t1 = std::move(t4);
+  t3.swap(t2);
+
+  bool valid = t1.valid();
+  (void)valid;
+
+  future<move_only> f1 = t1.get_future();
+
+  t1(42);
+}
+
+void packaged_task_void_compile_test()
+{
+  packaged_task<void()> t1([]{});
+  packaged_task<void()> t2(std::allocator_arg, std::allocator<char>(), []{});
+
+  future<void> f1 = t1.get_future();
+
+  t1();
+}
+
+void when_all_compile_test()
+{
+  promise<move_only> p1;
+  promise<void> p2;
+  std::vector<future<int>> v1;
+
+  future<std::vector<future<int>>> f1 = std::experimental::when_all(v1.begin(), v1.end());
+  future<std::tuple<future<move_only>, future<void>>> f2 = std::experimental::when_all(p1.get_future(), p2.get_future());
+  future<std::tuple<>> f3 = std::experimental::when_all();
+
+  using any_vector = std::experimental::when_any_result<std::vector<future<int>>>;
+  using any_tuple = std::experimental::when_any_result<std::tuple<future<move_only>, future<void>>>;
+  future<any_vector> f4 = std::experimental::when_any(v1.begin(), v1.end());
+  future<any_tuple> f5 = std::experimental::when_any(p1.get_future(), p2.get_future());
+}
+
+template<class R>
+future<R> make_ready_future(R value)
+{
+  promise<R> p;
+  p.set_value(std::move(value));
+  return p.get_future();
+}
+
+// Inputs that are ready before the combinator attaches to them.
+void when_all_ready_inputs_test()
+{
+  std::vector<future<int>> v1;
+  v1.push_back(make_ready_future(1));
+  v1.push_back(make_ready_future(2));
+  std::vector<future<int>> r1 = std::experimental::when_all(v1.begin(), v1.end()).get();
+  assert(r1.size() == 2 && r1[0].get() == 1 && r1[1].get() == 2);
+
+  std::vector<future<int>> v2;
+  v2.push_back(make_ready_future(1));
+  v2.push_back(make_ready_future(2));
+  auto r2 = std::experimental::when_any(v2.begin(), v2.end()).get();
+  assert(r2.index == 0 && r2.futures.size() == 2 && r2.futures[1].get() == 2);
+
+  auto r3 = std::experimental::when_all(make_ready_future(1), make_ready_future(2)).get();
+  assert(std::get<0>(r3).get() == 1 && std::get<1>(r3).get() == 2);
+
+  promise<int> p1;
+  auto f4 = std::experimental::when_any(p1.get_future(), make_ready_future(2));
+  auto r4 = f4.get();
+  assert(r4.index == 1 && std::get<1>(r4.futures).get() == 2);
+  p1.set_value(1);
+  assert(std::get<0>(r4.futures).get() == 1);
+}
+
+// The function passed to then() is destroyed once it has run, even though
+// the future it returned is still outstanding.
+void then_releases_function_test()
+{
+  auto captured = std::make_shared<int>(1);
+  std::weak_ptr<int> observer = captured;
+
+  promise<int> p;
+  future<int> f = p.get_future().then([c = std::move(captured)](future<int> r) { return r.get() + *c; });
+  p.set_value(1);
+  assert(observer.expired());
+  assert(f.get() == 2);
+}
+
+// An executor that destroys every function without running it.
+struct dropping_executor
+{
+  friend bool operator==(const dropping_executor&, const dropping_executor&) noexcept { return true; }
+  friend bool operator!=(const dropping_executor&, const dropping_executor&) noexcept { return false; }
+  template<class Function> void execute(Function) const {}
+  constexpr bool query(execution::oneway_t) const { return true; }
+  constexpr bool query(execution::single_t) const { return true; }
+};
+
+// A continuation that its executor never runs breaks the returned future's
+// promise.
+void then_dropped_continuation_test()
+{
+  promise<int> p1;
+  future<int> f1 = p1.get_future().then(dropping_executor{}, [](future<int> r) { return r.get(); });
+  p1.set_value(1);
+  assert(f1.is_ready());
+  try
+  {
+    f1.get();
+    assert(false);
+  }
+  catch (const std::future_error& e)
+  {
+    assert(e.code() == std::future_errc::broken_promise);
+  }
+
+  future<int> f2 = make_ready_future(1).then(dropping_executor{}, [](future<int> r) { return r.get(); });
+  assert(f2.is_ready());
+}
+
+#if defined(__cpp_impl_coroutine)
+std::experimental::task<int> task_compile_test()
+{
+  promise<int> p1;
+  int i1 = co_await p1.get_future();
+  int i2 = co_await std::experimental::spawn([]() -> std::experimental::task<int> { co_return 1; }());
+  co_return i1 + i2;
+}
+
+future<void> future_coroutine_compile_test()
+{
+  int i1 = co_await task_compile_test();
+  (void)i1;
+}
+#endif
+
 int main()
 {
+  when_all_ready_inputs_test();
+  then_releases_function_test();
+  then_dropped_continuation_test();
 }
@@ -1,7 +1,14 @@
 #include <experimental/thread_pool>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace execution = std::experimental::execution;
 using std::experimental::static_thread_pool;
+using std::experimental::stop_source;
 
 template<class Executor>
 void static_thread_pool_executor_compile_test(Executor ex1)
@@ -37,6 +44,20 @@ void static_thread_pool_executor_compile_test(Executor ex1)
 
   auto alloc = execution::query(cex1, execution::allocator);
   (void)alloc;
+
+  execution::bulk_chunk_size_t chunk = execution::query(cex1, execution::bulk_chunk_size);
+  (void)chunk;
+  static_assert(execution::bulk_chunk_size.value() == 0, "default chunk size must let the executor choose");
+  static_assert(execution::bulk_chunk_size.partition() == execution::bulk_chunk_size_t::partitioning::guided, "default partitioning must be guided");
+
+  execution::locality_t locality = execution::query(cex1, execution::locality);
+  (void)locality;
+
+  execution::priority_t priority = execution::query(cex1, execution::priority);
+  (void)priority;
+
+  execution::cancellation_t cancellation = execution::query(cex1, execution::cancellation);
+  (void)cancellation;
 }
 
 template<class Executor>
@@ -61,6 +82,9 @@ void static_thread_pool_oneway_executor_compile_test(Executor ex1)
   static_thread_pool_oneway_executor_compile_test(execution::require(cex1, execution::mapping.thread));
   static_thread_pool_oneway_executor_compile_test(execution::require(cex1, execution::allocator));
   static_thread_pool_oneway_executor_compile_test(execution::require(cex1, execution::allocator(std::allocator<void>())));
+  static_thread_pool_oneway_executor_compile_test(execution::require(cex1, execution::locality(0)));
+  static_thread_pool_oneway_executor_compile_test(execution::require(cex1, execution::priority(execution::priority_t::high)));
+  static_thread_pool_oneway_executor_compile_test(execution::require(cex1, execution::cancellation(stop_source().get_token())));
 
   static_thread_pool_oneway_executor_compile_test(execution::prefer(cex1, execution::blocking.never));
   static_thread_pool_oneway_executor_compile_test(execution::prefer(cex1, execution::blocking.possibly));
@@ -76,6 +100,7 @@ void static_thread_pool_oneway_executor_compile_test(Executor ex1)
   static_thread_pool_oneway_executor_compile_test(execution::prefer(cex1, execution::mapping.new_thread));
   static_thread_pool_oneway_executor_compile_test(execution::prefer(cex1, execution::allocator));
   static_thread_pool_oneway_executor_compile_test(execution::prefer(cex1, execution::allocator(std::allocator<void>())));
+  static_thread_pool_oneway_executor_compile_test(execution::prefer(cex1, execution::priority(execution::priority_t::low)));
 }
 
 template<class Executor>
@@ -143,6 +168,11 @@ void static_thread_pool_bulk_oneway_executor_compile_test(Executor ex1)
   static_thread_pool_bulk_oneway_executor_compile_test(execution::require(cex1, execution::mapping.thread));
   static_thread_pool_bulk_oneway_executor_compile_test(execution::require(cex1, execution::allocator));
   static_thread_pool_bulk_oneway_executor_compile_test(execution::require(cex1, execution::allocator(std::allocator<void>())));
+  static_thread_pool_bulk_oneway_executor_compile_test(execution::require(cex1, execution::bulk_chunk_size(64)));
+  static_thread_pool_bulk_oneway_executor_compile_test(execution::require(cex1, execution::bulk_chunk_size(0, execution::bulk_chunk_size_t::partitioning::static_)));
+  static_thread_pool_bulk_oneway_executor_compile_test(execution::require(cex1, execution::locality(0)));
+  static_thread_pool_bulk_oneway_executor_compile_test(execution::require(cex1, execution::priority(execution::priority_t::low)));
+  static_thread_pool_bulk_oneway_executor_compile_test(execution::require(cex1, execution::cancellation(stop_source().get_token())));
 
   static_thread_pool_bulk_oneway_executor_compile_test(execution::prefer(cex1, execution::blocking.never));
   static_thread_pool_bulk_oneway_executor_compile_test(execution::prefer(cex1, execution::blocking.possibly));
@@ -158,6 +188,7 @@ void static_thread_pool_bulk_oneway_executor_compile_test(Executor ex1)
   static_thread_pool_bulk_oneway_executor_compile_test(execution::prefer(cex1, execution::mapping.new_thread));
   static_thread_pool_bulk_oneway_executor_compile_test(execution::prefer(cex1, execution::allocator));
   static_thread_pool_bulk_oneway_executor_compile_test(execution::prefer(cex1, execution::allocator(std::allocator<void>())));
+  static_thread_pool_bulk_oneway_executor_compile_test(execution::prefer(cex1, execution::bulk_chunk_size(16, execution::bulk_chunk_size_t::partitioning::guided)));
 }
 
 template<class Executor>
@@ -189,6 +220,8 @@ void static_thread_pool_bulk_twoway_executor_compile_test(Executor ex1)
   static_thread_pool_bulk_twoway_executor_compile_test(execution::require(cex1, execution::mapping.thread));
   static_thread_pool_bulk_twoway_executor_compile_test(execution::require(cex1, execution::allocator));
   static_thread_pool_bulk_twoway_executor_compile_test(execution::require(cex1, execution::allocator(std::allocator<void>())));
+  static_thread_pool_bulk_twoway_executor_compile_test(execution::require(cex1, execution::bulk_chunk_size(64)));
+  static_thread_pool_bulk_twoway_executor_compile_test(execution::require(cex1, execution::bulk_chunk_size(0, execution::bulk_chunk_size_t::partitioning::static_)));
 
   static_thread_pool_bulk_twoway_executor_compile_test(execution::prefer(cex1, execution::blocking.never));
   static_thread_pool_bulk_twoway_executor_compile_test(execution::prefer(cex1, execution::blocking.possibly));
@@ -204,6 +237,7 @@ void static_thread_pool_bulk_twoway_executor_compile_test(Executor ex1)
   static_thread_pool_bulk_twoway_executor_compile_test(execution::prefer(cex1, execution::mapping.new_thread));
   static_thread_pool_bulk_twoway_executor_compile_test(execution::prefer(cex1, execution::allocator));
   static_thread_pool_bulk_twoway_executor_compile_test(execution::prefer(cex1, execution::allocator(std::allocator<void>())));
+  static_thread_pool_bulk_twoway_executor_compile_test(execution::prefer(cex1, execution::bulk_chunk_size(16, execution::bulk_chunk_size_t::partitioning::guided)));
 }
 
 void static_thread_pool_compile_test()
@@ -212,15 +246,38 @@ void static_thread_pool_compile_test()
 
   static_thread_pool pool1(0);
   static_thread_pool pool2(static_cast<std::size_t>(0));
+  static_thread_pool pool3(0, static_thread_pool::scheduling::shared_queue);
+  static_thread_pool pool4(0, static_thread_pool::scheduling::work_stealing);
+  static_thread_pool::options options5;
+  options5.schedule = static_thread_pool::scheduling::work_stealing;
+  options5.steal_continuations = true;
+  static_thread_pool pool5(0, options5);
+  static_thread_pool::options options6;
+  options6.idle = static_thread_pool::idle_policy{1000, 10};
+  static_thread_pool pool6(0, options6);
+  static_thread_pool::options options7;
+  options7.nodes = static_thread_pool::numa_nodes();
+  static_thread_pool pool7(0, options7);
+  static_thread_pool::options options8;
+  options8.starvation_limit = 4;
+  static_thread_pool pool8(0, options8);
 
   pool1.attach();
 
   pool1.stop();
 
   pool1.wait();
+  pool2.wait(static_thread_pool::wait_mode::help);
 
   executor_type ex1(pool1.executor());
 
+  ex1.execute_after(std::chrono::milliseconds(1), []{});
+  ex1.execute_at(std::chrono::steady_clock::now(), []{});
+  ex1.execute_at(std::chrono::system_clock::now(), []{});
+
+  auto f1 = execution::require(ex1, execution::twoway).twoway_execute([]{ return 1; });
+  pool1.run_until(f1);
+
   static_thread_pool_oneway_executor_compile_test(pool1.executor());
   static_thread_pool_oneway_executor_compile_test(execution::require(pool1.executor(), execution::oneway));
   static_thread_pool_oneway_executor_compile_test(execution::require(pool1.executor(), execution::twoway, execution::oneway));
@@ -235,6 +292,278 @@ void static_thread_pool_compile_test()
   static_thread_pool_bulk_twoway_executor_compile_test(execution::require(pool1.executor(), execution::bulk));
 }
 
+// Occupies one of the pool's threads until released, so that functions
+// submitted in the meantime stay queued.
+struct blocker
+{
+  std::atomic<bool> released{false};
+
+  template<class Executor>
+  void block(const Executor& ex)
+  {
+    ex.execute([this]{ while (!released) std::this_thread::yield(); });
+  }
+
+  void release() { released = true; }
+};
+
+void static_thread_pool_cancellation_test()
+{
+  static_thread_pool pool(1);
+  blocker b;
+  b.block(pool.executor());
+
+  // A queued function is dropped once stop is requested.
+  std::atomic<int> calls{0};
+  stop_source s1;
+  execution::require(pool.executor(), execution::cancellation(s1.get_token())).execute([&calls]{ ++calls; });
+  s1.request_stop();
+
+  // A bulk operation hands out no further indices once stop is requested.
+  std::atomic<std::size_t> indices{0};
+  stop_source s2;
+  execution::require(pool.executor(), execution::cancellation(s2.get_token()), execution::bulk_chunk_size(1))
+    .bulk_execute([&indices, &s2](std::size_t i, int&){ ++indices; if (i == 9) s2.request_stop(); }, 100, []{ return 0; });
+
+  // A two-way function submitted after stop is requested breaks its promise.
+  stop_source s3;
+  s3.request_stop();
+  auto f = execution::require(pool.executor(), execution::twoway, execution::cancellation(s3.get_token()))
+    .twoway_execute([&calls]{ return ++calls; });
+
+  b.release();
+  pool.wait();
+  assert(calls == 0);
+  assert(indices == 10);
+  try
+  {
+    f.get();
+    assert(false);
+  }
+  catch (const std::future_error& e)
+  {
+    assert(e.code() == std::future_errc::broken_promise);
+  }
+}
+
+void static_thread_pool_timer_test()
+{
+  using std::chrono::milliseconds;
+  using std::chrono::steady_clock;
+
+  static_thread_pool pool(1);
+  std::mutex mutex;
+  std::vector<int> order;
+  bool early = false;
+
+  // Timers submitted out of order fire in deadline order, and none early.
+  for (int delay : {30, 10, 20})
+  {
+    steady_clock::time_point deadline = steady_clock::now() + milliseconds(delay);
+    pool.executor().execute_after(milliseconds(delay), [&, delay, deadline]
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          early = early || steady_clock::now() < deadline;
+          order.push_back(delay);
+        });
+  }
+
+  // A timer whose stop is requested before its deadline does not fire.
+  stop_source s;
+  bool cancelled_fired = false;
+  execution::require(pool.executor(), execution::cancellation(s.get_token()))
+    .execute_after(milliseconds(10), [&cancelled_fired]{ cancelled_fired = true; });
+  s.request_stop();
+
+  // The pool's thread stays until the pending timers have fired.
+  pool.wait();
+  assert(!early);
+  assert((order == std::vector<int>{10, 20, 30}));
+  assert(!cancelled_fired);
+}
+
+void static_thread_pool_wait_help_test()
+{
+  // A pool without threads is drained by the thread that waits for it.
+  static_thread_pool pool(0);
+  std::atomic<int> count{0};
+  for (int i = 0; i < 10; ++i)
+    pool.executor().execute([&count]{ ++count; });
+  pool.wait(static_thread_pool::wait_mode::help);
+  assert(count == 10);
+}
+
+void static_thread_pool_run_until_test()
+{
+  using std::chrono::milliseconds;
+  using std::chrono::seconds;
+  using std::chrono::steady_clock;
+
+  // The calling thread runs the function that makes the future ready.
+  static_thread_pool pool1(0);
+  auto f1 = execution::require(pool1.executor(), execution::twoway).twoway_execute([]{ return 1; });
+  pool1.run_until(f1);
+  assert(f1.get() == 1);
+
+  // The calling thread wakes as soon as another thread makes the future
+  // ready, even while it waits for a distant timer.
+  static_thread_pool pool2(0);
+  stop_source s;
+  execution::require(pool2.executor(), execution::cancellation(s.get_token())).execute_after(seconds(60), []{});
+  s.request_stop();
+  std::experimental::promise<int> p;
+  auto f2 = p.get_future();
+  steady_clock::time_point set_at;
+  std::thread t([&]{ std::this_thread::sleep_for(milliseconds(10)); set_at = steady_clock::now(); p.set_value(2); });
+  pool2.run_until(f2);
+  steady_clock::time_point returned_at = steady_clock::now();
+  t.join();
+  assert(returned_at - set_at < milliseconds(500));
+  assert(f2.get() == 2);
+}
+
+// Resubmits itself at high priority until the low priority function runs.
+template<class Executor>
+struct high_priority_stream
+{
+  Executor ex;
+  std::atomic<int>* count;
+  std::atomic<bool>* low_ran;
+
+  void operator()() const
+  {
+    if (!*low_ran && ++*count < 1000)
+      ex.execute(*this);
+  }
+};
+
+void static_thread_pool_priority_test()
+{
+  using level = execution::priority_t;
+
+  // Queued functions run high before normal before low.
+  static_thread_pool pool1(1);
+  blocker b;
+  b.block(pool1.executor());
+  std::mutex mutex;
+  std::vector<char> order;
+  for (char c : {'l', 'n', 'h', 'l', 'n', 'h'})
+  {
+    auto ex = execution::require(pool1.executor(),
+        execution::priority(c == 'h' ? level::high : c == 'l' ? level::low : level::normal));
+    ex.execute([&mutex, &order, c]{ std::lock_guard<std::mutex> lock(mutex); order.push_back(c); });
+  }
+  b.release();
+  pool1.wait();
+  assert((order == std::vector<char>{'h', 'h', 'n', 'n', 'l', 'l'}));
+
+  // A low priority function is not starved by a steady stream of high
+  // priority functions.
+  static_thread_pool::options options;
+  options.starvation_limit = 4;
+  static_thread_pool pool2(1, options);
+  b.released = false;
+  b.block(pool2.executor());
+  std::atomic<int> count{0};
+  std::atomic<bool> low_ran{false};
+  execution::require(pool2.executor(), execution::priority(level::low)).execute([&low_ran]{ low_ran = true; });
+  auto high = execution::require(pool2.executor(), execution::priority(level::high), execution::blocking.never);
+  high.execute(high_priority_stream<decltype(high)>{high, &count, &low_ran});
+  b.release();
+  pool2.wait();
+  assert(low_ran);
+  assert(count < 1000);
+}
+
+// Forks nested functions and continuations from the pool's threads, pausing
+// between batches so that the threads go idle, and checks that every
+// function runs.
+void static_thread_pool_nested_work_test(const static_thread_pool::options& options)
+{
+  static_thread_pool pool(4, options);
+  std::atomic<std::size_t> count{0};
+  auto ex = execution::require(pool.executor(), execution::blocking.never);
+  for (int batch = 0; batch < 4; ++batch)
+  {
+    for (int i = 0; i < 25; ++i)
+    {
+      ex.execute([ex, &count]
+          {
+            ++count;
+            for (int j = 0; j < 10; ++j)
+              ex.execute([&count]{ ++count; });
+            auto cex = execution::require(ex, execution::relationship.continuation);
+            cex.execute([&count]{ ++count; });
+            cex.execute([&count]{ ++count; });
+          });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  pool.wait();
+  assert(count == 100 * 13);
+}
+
+void static_thread_pool_work_stealing_test()
+{
+  static_thread_pool::options options;
+  options.schedule = static_thread_pool::scheduling::work_stealing;
+  static_thread_pool_nested_work_test(options);
+}
+
+void static_thread_pool_continuation_test()
+{
+  // Continuations spill from the thread-private queue.
+  static_thread_pool_nested_work_test(static_thread_pool::options{});
+
+  // Continuations are published for idle threads to steal.
+  static_thread_pool::options options;
+  options.schedule = static_thread_pool::scheduling::work_stealing;
+  options.steal_continuations = true;
+  static_thread_pool_nested_work_test(options);
+}
+
+void static_thread_pool_idle_policy_test()
+{
+  // Idle threads spin and yield before they park.
+  static_thread_pool::options options;
+  options.idle = static_thread_pool::idle_policy{1000, 10};
+  static_thread_pool_nested_work_test(options);
+  options.schedule = static_thread_pool::scheduling::work_stealing;
+  static_thread_pool_nested_work_test(options);
+}
+
+void static_thread_pool_locality_test()
+{
+  auto nodes = static_thread_pool::numa_nodes();
+  assert(!nodes.empty());
+  for (auto& cpus : nodes)
+    assert(!cpus.empty());
+
+  // Functions bound to each node are submitted from outside the pool.
+  static_thread_pool::options options;
+  options.nodes = nodes;
+  static_thread_pool pool(nodes.size() * 2, options);
+  std::atomic<std::size_t> count{0};
+  for (std::size_t node = 0; node < nodes.size(); ++node)
+  {
+    auto ex = execution::require(pool.executor(), execution::locality(node));
+    for (int i = 0; i < 100; ++i)
+      ex.execute([&count]{ ++count; });
+    ex.bulk_execute([&count](std::size_t, int&){ ++count; }, 100, []{ return 0; });
+  }
+  pool.wait();
+  assert(count == nodes.size() * 200);
+}
+
 int main()
 {
+  static_thread_pool_cancellation_test();
+  static_thread_pool_timer_test();
+  static_thread_pool_wait_help_test();
+  static_thread_pool_run_until_test();
+  static_thread_pool_priority_test();
+  static_thread_pool_work_stealing_test();
+  static_thread_pool_continuation_test();
+  static_thread_pool_idle_policy_test();
+  static_thread_pool_locality_test();
 }